@@ -38,10 +38,13 @@ static uint32_t emuFeatures;
 static bool     useOs5;
 #endif
 static bool     firstRetroRunCall;
+static bool     canDupeFrames;
 static bool     dontRenderGraffiti;
 static bool     useJoystickAsMouse;
 static float    touchCursorX;
 static float    touchCursorY;
+static float    lastTouchCursorX;
+static float    lastTouchCursorY;
 static char     contentPath[PATH_MAX_LENGTH];
 static uint16_t mouseCursorOldArea[32 * 32];
 static bool     runningImgFile;
@@ -124,6 +127,21 @@ static void unrenderMouseCursor(int16_t screenX, int16_t screenY){
    }
 }
 
+static void writeSdCardRange(RFILE* sdImgFile, uint32_t offset, uint32_t size){
+   //read through the emulator instead of using flashChipData so an overlay card writes what the Palm sees
+   static uint8_t buffer[0x10000];
+
+   filestream_seek(sdImgFile, offset, RETRO_VFS_SEEK_POSITION_START);
+   while(size > 0){
+      uint32_t length = FAST_MIN(size, sizeof(buffer));
+
+      emulatorReadSdCard(buffer, offset, length);
+      filestream_write(sdImgFile, buffer, length);
+      offset += length;
+      size -= length;
+   }
+}
+
 static void fallback_log(enum retro_log_level level, const char *fmt, ...){
    va_list va;
 
@@ -159,6 +177,13 @@ static void check_variables(bool booting){
       if(environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
          if(!strcmp(var.value, "enabled"))
             emuFeatures |= FEATURE_DURABLE;
+      
+#if defined(EMU_MULTITHREADED)
+      var.key = "palm_emu_feature_pipelined_video";
+      if(environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+         if(!strcmp(var.value, "enabled"))
+            emuFeatures |= FEATURE_PIPELINED_VIDEO;
+#endif
    }
 
    var.key = "palm_emu_use_joystick_as_mouse";
@@ -232,6 +257,10 @@ void retro_set_environment(retro_environment_t cb){
       { "palm_emu_feature_synced_rtc", "Force Match System Clock; disabled|enabled" },
       { "palm_emu_feature_hle_apis", "HLE API Implementations; disabled|enabled" },
       { "palm_emu_feature_durable", "Ignore Invalid Behavior; disabled|enabled" },
+#if defined(EMU_MULTITHREADED)
+      //without threads the render runs after the CPU anyway and this would only add a frame of lag
+      { "palm_emu_feature_pipelined_video", "Render On Another Thread(1 Frame Behind); disabled|enabled" },
+#endif
       { "palm_emu_use_joystick_as_mouse", "Use Left Joystick As Mouse; disabled|enabled" },
       { "palm_emu_disable_graffiti", "Disable Graffiti Area; disabled|enabled" },
 #if defined(EMU_SUPPORT_PALM_OS5)
@@ -396,18 +425,27 @@ void retro_run(void){
    //run emulator
    emulatorRunFrame();
    
-   //draw mouse
-   if(useJoystickAsMouse)
-      renderMouseCursor(touchCursorX, touchCursorY);
-   
-   video_cb(palmFramebuffer, palmFramebufferWidth, screenYEnd, palmFramebufferWidth * sizeof(uint16_t));
+   if(canDupeFrames && !palmFramebufferChanged && !(useJoystickAsMouse && (touchCursorX != lastTouchCursorX || touchCursorY != lastTouchCursorY))){
+      //nothing on screen changed, let the frontend reuse the last frame
+      video_cb(NULL, palmFramebufferWidth, screenYEnd, palmFramebufferWidth * sizeof(uint16_t));
+   }
+   else{
+      //draw mouse
+      if(useJoystickAsMouse)
+         renderMouseCursor(touchCursorX, touchCursorY);
+      
+      video_cb(palmFramebuffer, palmFramebufferWidth, screenYEnd, palmFramebufferWidth * sizeof(uint16_t));
+      
+      //repair damage done to the framebuffer by the mouse cursor
+      if(useJoystickAsMouse)
+         unrenderMouseCursor(touchCursorX, touchCursorY);
+      
+      lastTouchCursorX = touchCursorX;
+      lastTouchCursorY = touchCursorY;
+   }
    audio_cb(palmAudio, AUDIO_SAMPLES_PER_FRAME);
    if(led_cb)
       led_cb(0, palmMisc.powerButtonLed);
-   
-   //repair damage done to the framebuffer by the mouse cursor
-   if(useJoystickAsMouse)
-      unrenderMouseCursor(touchCursorX, touchCursorY);
 }
 
 bool retro_load_game(const struct retro_game_info *info){
@@ -432,6 +470,9 @@ bool retro_load_game(const struct retro_game_info *info){
    //updates the emulator configuration
    check_variables(true);
    
+   if(!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &canDupeFrames))
+      canDupeFrames = false;
+   
    environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &systemDir);
    
    if(info && !string_is_empty(info->path)){
@@ -669,11 +710,28 @@ void retro_unload_game(void){
 #endif
             strlcat(sdImgPath, ".os4", PATH_MAX_LENGTH);
          strlcat(sdImgPath, ".sd.img", PATH_MAX_LENGTH);
-         sdImgFile = filestream_open(sdImgPath, RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+         //the image was loaded from this file, only write back the blocks that changed
+         sdImgFile = filestream_open(sdImgPath, RETRO_VFS_FILE_ACCESS_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+         if(sdImgFile && filestream_get_size(sdImgFile) != palmSdCard.flashChipSize){
+            //the card was replaced by a state load, the old image is no use
+            filestream_close(sdImgFile);
+            sdImgFile = NULL;
+         }
          if(sdImgFile){
-            filestream_write(sdImgFile, palmSdCard.flashChipData, palmSdCard.flashChipSize);
+            uint32_t changedOffset;
+            uint32_t changedSize;
+            
+            while(emulatorGetSdCardChangedRange(&changedOffset, &changedSize))
+               writeSdCardRange(sdImgFile, changedOffset, changedSize);
             filestream_close(sdImgFile);
          }
+         else{
+            sdImgFile = filestream_open(sdImgPath, RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+            if(sdImgFile){
+               writeSdCardRange(sdImgFile, 0, palmSdCard.flashChipSize);
+               filestream_close(sdImgFile);
+            }
+         }
       }
    }
    
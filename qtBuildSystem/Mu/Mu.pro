@@ -83,6 +83,10 @@ CONFIG(debug, debug|release){
 }else{
     # release build, go fast
     DEFINES += EMU_NO_SAFETY
+    # the m68k recompiler is still experimental and off by default, run qmake with "CONFIG+=m68k_dynarec" to try it
+    m68k_dynarec:cpu_x86_64:!windows{
+        DEFINES += EMU_M68K_DYNAREC
+    }
 }
 
 support_palm_os5{
@@ -219,6 +223,7 @@ SOURCES += \
     ../../src/m68k/m68kopdm.c \
     ../../src/m68k/m68kopnz.c \
     ../../src/m68k/m68kops.c \
+    ../../src/m68k/m68ktranslate_x86_64.c \
     ../../src/expansionHardware.c \
     ../../src/m515Bus.c
 
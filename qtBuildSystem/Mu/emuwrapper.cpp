@@ -105,7 +105,7 @@ void EmuWrapper::emuThreadRun(){
       if(emuRunning){
          emuPaused = false;
          if(!emuNewFrameReady){
-            palmInput = emuInput;
+            queueInput();
             emulatorRunFrame();
             emuNewFrameReady = true;
          }
@@ -118,6 +118,36 @@ void EmuWrapper::emuThreadRun(){
    }
 }
 
+void EmuWrapper::inputChanged(){
+   std::lock_guard<std::mutex> lock(emuInputLock);
+
+   //nothing takes inputs while paused, once the core cant hold any more keep replacing the newest since that is what the frame has to end with
+   if(emuInputQueue.size() >= INPUT_QUEUE_SIZE - 1){
+      emuInputQueue.back() = emuInput;
+      emuInputQueueTimes.back() = std::chrono::steady_clock::now();
+      return;
+   }
+
+   emuInputQueue.push_back(emuInput);
+   emuInputQueueTimes.push_back(std::chrono::steady_clock::now());
+}
+
+void EmuWrapper::queueInput(){
+   //the input that came in while the last frame was running is spread over the next one the same way, fast pen strokes keep all there points
+   std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+   std::lock_guard<std::mutex> lock(emuInputLock);
+   double frameLength = std::chrono::duration<double>(frameStart - emuLastFrameStart).count();
+
+   for(qsizetype index = 0; index < emuInputQueue.size(); index++){
+      double inputTime = std::chrono::duration<double>(emuInputQueueTimes[index] - emuLastFrameStart).count();
+
+      emulatorQueueInput(&emuInputQueue[index], frameLength > 0.0 ? inputTime / frameLength : 0.0);
+   }
+   emuInputQueue.clear();
+   emuInputQueueTimes.clear();
+   emuLastFrameStart = frameStart;
+}
+
 void EmuWrapper::writeOutSaves(){
    if(emuRamFilePath != ""){
       QFile ramFile(emuRamFilePath);
@@ -134,22 +164,76 @@ void EmuWrapper::writeOutSaves(){
 
       delete[] emuRamData;
    }
-   if(emuSdCardFilePath != ""){
+   if(emuSdCardFilePath != "" && emuSdCardFile.isOpen() && emulatorGetSdCardSize() > 0){
+      uint8_t sdCardWriteBuffer[0x1000];
+      uint32_t changedOffset;
+      uint32_t changedSize;
+
+      //the image is mapped copy on write, only the blocks the emu changed need to be written back
+      if((uint64_t)emuSdCardFile.size() != emulatorGetSdCardSize())
+         emuSdCardFile.resize(emulatorGetSdCardSize());
+      while(emulatorGetSdCardChangedRange(&changedOffset, &changedSize)){
+         //read through the emulator, flashChipData is only the base image on an overlay card
+         emuSdCardFile.seek(changedOffset);
+         while(changedSize > 0){
+            uint32_t length = qMin(changedSize, (uint32_t)sizeof(sdCardWriteBuffer));
+
+            emulatorReadSdCard(sdCardWriteBuffer, changedOffset, length);
+            emuSdCardFile.write((const char*)sdCardWriteBuffer, length);
+            changedOffset += length;
+            changedSize -= length;
+         }
+      }
+      emuSdCardFile.flush();
+   }
+   else if(emuSdCardFilePath != "" && !emuSdCardFile.isOpen()){
       uint32_t emuSdCardSize = emulatorGetSdCardSize();
       uint8_t* emuSdCardData = new uint8_t[emuSdCardSize];
 
+      //the card didnt come from the save file(inserted by a state load), write it all out
       if(emulatorGetSdCardData(emuSdCardData, emuSdCardSize) == EMU_ERROR_NONE){
          QFile sdCardFile(emuSdCardFilePath);
 
-         //save out SD card before exit
          if(sdCardFile.open(QFile::WriteOnly | QFile::Truncate)){
             sdCardFile.write((const char*)emuSdCardData, emuSdCardSize);
             sdCardFile.close();
          }
       }
+
+      delete[] emuSdCardData;
    }
 }
 
+uint32_t EmuWrapper::insertSdCardFile(const QString& path, bool writeBack, sd_card_info_t* sdInfo){
+   uchar* sdCardData;
+   uint32_t error;
+
+   ejectSdCardFile();
+
+   emuSdCardFile.setFileName(path);
+   if(!emuSdCardFile.open((writeBack ? QFile::ReadWrite : QFile::ReadOnly) | QFile::ExistingOnly))
+      return EMU_ERROR_INVALID_PARAMETER;
+
+   //private mapping, the emu can write to it without touching the file until writeOutSaves()
+   sdCardData = emuSdCardFile.map(0, emuSdCardFile.size(), QFileDevice::MapPrivateOption);
+   if(!sdCardData){
+      emuSdCardFile.close();
+      return EMU_ERROR_OUT_OF_MEMORY;
+   }
+
+   error = emulatorMapSdCard((uint8_t*)sdCardData, emuSdCardFile.size(), sdInfo);
+   if(error != EMU_ERROR_NONE)
+      emuSdCardFile.close();
+
+   return error;
+}
+
+void EmuWrapper::ejectSdCardFile(){
+   //the emu must let go of the image before it is unmapped
+   emulatorEjectSdCard();
+   emuSdCardFile.close();
+}
+
 uint32_t EmuWrapper::init(const QString& assetPath, bool useOs5, uint32_t features, bool fastBoot){
    if(!emuRunning && !emuInited){
       //start emu
@@ -159,7 +243,6 @@ uint32_t EmuWrapper::init(const QString& assetPath, bool useOs5, uint32_t featur
       QFile romFile(assetPath + "/palmos" + osVersion + "-" + model + ".rom");
       QFile bootloaderFile(assetPath + "/bootloader-" + model + ".rom");
       QFile ramFile(assetPath + "/userdata-" + model + ".ram");
-      QFile sdCardFile(assetPath + "/sd-" + model + ".img");
       bool hasBootloader = true;
 
       //used to mark saves with there OS version and prevent corruption
@@ -183,12 +266,13 @@ uint32_t EmuWrapper::init(const QString& assetPath, bool useOs5, uint32_t featur
             ramFile.close();
          }
 
-         if(sdCardFile.open(QFile::ReadOnly | QFile::ExistingOnly)){
-            emulatorInsertSdCard((uint8_t*)sdCardFile.readAll().data(), sdCardFile.size(), NULL);
-            sdCardFile.close();
-         }
+         //its OK if this fails, there just wont be an SD card
+         insertSdCardFile(assetPath + "/sd-" + model + ".img", true, NULL);
 
          emuInput = palmInput;
+         emuInputQueue.clear();
+         emuInputQueueTimes.clear();
+         emuLastFrameStart = std::chrono::steady_clock::now();
          emuRamFilePath = assetPath + "/userdata-" + model + ".ram";
          emuSdCardFilePath = assetPath + "/sd-" + model + ".img";
          emuSaveStatePath = assetPath + "/states-" + model + ".states";
@@ -227,6 +311,7 @@ void EmuWrapper::exit(){
    if(emuInited){
       writeOutSaves();
       emulatorDeinit();
+      emuSdCardFile.close();
    }
 }
 
@@ -269,7 +354,7 @@ uint32_t EmuWrapper::bootFromFile(const QString& mainPath){
    QFileInfo pathInfo(mainPath);
    QFile appFile(mainPath);
    QFile ramFile(mainPath + "." + emuOsName + ".ram");
-   QFile sdCardFile(mainPath + "." + emuOsName + ".sd.img");
+   QString sdCardPath = mainPath + "." + emuOsName + ".sd.img";
    QString suffix = QFileInfo(mainPath).suffix().toLower();
    bool hasSaveRam;
    bool hasSaveSdCard;
@@ -282,30 +367,24 @@ uint32_t EmuWrapper::bootFromFile(const QString& mainPath){
 
    //its OK if these fail, the buffer will just be NULL, 0 if they do
    hasSaveRam = ramFile.open(QFile::ReadOnly | QFile::ExistingOnly);
-   hasSaveSdCard = suffix != "img" ? sdCardFile.open(QFile::ReadOnly | QFile::ExistingOnly) : false;
+   hasSaveSdCard = suffix != "img" ? QFile::exists(sdCardPath) : false;
 
    //fully clear the emu
-   emulatorEjectSdCard();
+   ejectSdCardFile();
    emulatorHardReset();
 
    if(hasSaveRam)
       emulatorLoadRam((uint8_t*)ramFile.readAll().data(), ramFile.size());
    if(hasSaveSdCard)
-      emulatorInsertSdCard((uint8_t*)sdCardFile.readAll().data(), sdCardFile.size(), NULL);
+      insertSdCardFile(sdCardPath, true, NULL);
 
    //its OK if these fail
    if(hasSaveRam)
       ramFile.close();
-   if(hasSaveSdCard)
-      sdCardFile.close();
 
    launcherBootInstantly(hasSaveRam);
 
    if(appFile.open(QFile::ReadOnly | QFile::ExistingOnly)){
-      QByteArray fileBuffer = appFile.readAll();
-
-      appFile.close();
-
       if(suffix == "img"){
          QFile infoFile(mainPath.mid(0, mainPath.length() - 3) + "info");//swap "img" for "info"
          sd_card_info_t sdInfo;
@@ -317,11 +396,17 @@ uint32_t EmuWrapper::bootFromFile(const QString& mainPath){
             infoFile.close();
          }
 
-         error = emulatorInsertSdCard((uint8_t*)fileBuffer.data(), fileBuffer.size(), &sdInfo);
+         //booted SD card images are never written back, changes are discarded with the private mapping
+         appFile.close();
+         error = insertSdCardFile(mainPath, false, &sdInfo);
          if(error != EMU_ERROR_NONE)
             goto errorOccurred;
       }
       else{
+         QByteArray fileBuffer = appFile.readAll();
+
+         appFile.close();
+
          if(!hasSaveRam){
             error = launcherInstallFile((uint8_t*)fileBuffer.data(), fileBuffer.size());
             if(error != EMU_ERROR_NONE)
@@ -335,7 +420,7 @@ uint32_t EmuWrapper::bootFromFile(const QString& mainPath){
 
    //everything worked, set output save files
    emuRamFilePath = mainPath + "." + emuOsName + ".ram";
-   emuSdCardFilePath = suffix != "img" ? mainPath + "." + emuOsName + ".sd.img" : "";//dont duplicate booted SD card images
+   emuSdCardFilePath = suffix != "img" ? sdCardPath : "";//dont duplicate booted SD card images
    emuSaveStatePath = mainPath + "." + emuOsName + ".states";
 
    //make the place to store the saves
@@ -345,7 +430,7 @@ uint32_t EmuWrapper::bootFromFile(const QString& mainPath){
    errorOccurred:
    if(error != EMU_ERROR_NONE){
       //try and recover from error
-      emulatorEjectSdCard();
+      ejectSdCardFile();
       emulatorHardReset();
    }
 
@@ -425,6 +510,7 @@ void EmuWrapper::setPenValue(float x, float y, bool touched){
    emuInput.touchscreenX = x;
    emuInput.touchscreenY = y;
    emuInput.touchscreenTouched = touched;
+   inputChanged();
 }
 
 void EmuWrapper::setKeyValue(uint8_t key, bool pressed){
@@ -470,8 +556,10 @@ void EmuWrapper::setKeyValue(uint8_t key, bool pressed){
          break;
 
       default:
-         break;
+         return;
    }
+
+   inputChanged();
 }
 
 QVector<QString>& EmuWrapper::debugGetLogEntrys(){
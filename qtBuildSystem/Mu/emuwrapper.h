@@ -4,9 +4,12 @@
 #include <QVector>
 #include <QString>
 #include <QByteArray>
+#include <QFile>
 
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <chrono>
 #include <stdint.h>
 
 #include "../../src/emulator.h"
@@ -26,10 +29,19 @@ private:
    QString           emuRamFilePath;
    QString           emuSdCardFilePath;
    QString           emuSaveStatePath;
-   input_t           emuInput;
+   QFile             emuSdCardFile;//the mapped SD card image, must stay open while the emu uses it
+   input_t           emuInput;//only used by the GUI thread, changes are passed to the emu thread through emuInputQueue
+   std::mutex        emuInputLock;
+   QVector<input_t>  emuInputQueue;
+   QVector<std::chrono::steady_clock::time_point> emuInputQueueTimes;
+   std::chrono::steady_clock::time_point emuLastFrameStart;
 
    void emuThreadRun();
+   void inputChanged();
+   void queueInput();
    void writeOutSaves();
+   uint32_t insertSdCardFile(const QString& path, bool writeBack, sd_card_info_t* sdInfo);
+   void ejectSdCardFile();
 
 public:
    enum{
@@ -70,8 +82,11 @@ public:
    bool newFrameReady() const{return emuNewFrameReady;}
    void frameHandled(){emuNewFrameReady = false;}
 
+   //returns a copy of the newest finished frame, safe any time on the m515, the Tungsten T3 draws every frame into the same buffer so only call it there before frameHandled() or while paused
+   const QPixmap getFramebuffer(){return QPixmap::fromImage(QImage((uchar*)emulatorGetFramebuffer(NULL), palmFramebufferWidth, palmFramebufferHeight, palmFramebufferWidth * sizeof(uint16_t), QImage::Format_RGB16).copy());}
+
    //calling these while newFrameReady() == false is undefined behavior, the other thread may be writing to them
-   const QPixmap getFramebuffer(){return QPixmap::fromImage(QImage((uchar*)palmFramebuffer, palmFramebufferWidth, palmFramebufferHeight, palmFramebufferWidth * sizeof(uint16_t), QImage::Format_RGB16));}
+   bool frameChanged() const{return palmFramebufferChanged;}
    const int16_t* getAudioSamples() const{return palmAudio;}
    bool getPowerButtonLed() const{return palmMisc.powerButtonLed;}
 
@@ -180,6 +180,9 @@ uint32_t MainWindow::getEmuFeatureList(){
    features |= settings->value("featureSyncedRtc", false).toBool() ? FEATURE_SYNCED_RTC : 0;
    features |= settings->value("featureHleApis", false).toBool() ? FEATURE_HLE_APIS : 0;
    features |= settings->value("featureDurable", false).toBool() ? FEATURE_DURABLE : 0;
+#if defined(EMU_MULTITHREADED)
+   features |= settings->value("featurePipelinedVideo", false).toBool() ? FEATURE_PIPELINED_VIDEO : 0;
+#endif
 
    return features;
 }
@@ -249,8 +252,8 @@ bool MainWindow::eventFilter(QObject* object, QEvent* event){
 //display
 void MainWindow::updateDisplay(){
    if(emu.newFrameReady()){
-      //video, this is doing bilinear filitering in software, this is why the Qt port is broken on Android, move this to a new thread if possible
-      ui->display->setPixmap(emu.getFramebuffer().scaled(ui->display->size().width(), ui->display->size().height(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+      bool frameChanged = emu.frameChanged();
+      QPixmap frame;
 
       //audio
       audioOut->write((const char*)emu.getAudioSamples(), AUDIO_SAMPLES_PER_FRAME * 2/*channels*/ * sizeof(int16_t));
@@ -258,8 +261,19 @@ void MainWindow::updateDisplay(){
       //power LED
       ui->powerButtonLed->setStyleSheet(emu.getPowerButtonLed() ? "background: lime" : "");
 
+      //the frame has to be copied before the next one starts, the Tungsten T3 has only 1 framebuffer and draws the next frame into it
+      //skipped when the picture and display size are the same as last time
+      if(frameChanged || ui->display->size() != displaySize)
+         frame = emu.getFramebuffer();
+
       //allow next frame to start
       emu.frameHandled();
+
+      //video, this is doing bilinear filitering in software, this is why the Qt port is broken on Android, move this to a new thread if possible
+      if(!frame.isNull()){
+         displaySize = ui->display->size();
+         ui->display->setPixmap(frame.scaled(displaySize.width(), displaySize.height(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+      }
    }
 }
 
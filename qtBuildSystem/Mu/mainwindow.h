@@ -10,6 +10,7 @@
 #include <QAudioOutput>
 #include <QIODevice>
 #include <QKeyEvent>
+#include <QSize>
 
 #include "emuwrapper.h"
 #include "settingsmanager.h"
@@ -89,5 +90,6 @@ private:
    QAudioOutput*    audioDevice;
    QIODevice*       audioOut;
    Ui::MainWindow*  ui;
+   QSize            displaySize;
    int              keyForButton[EmuWrapper::BUTTON_TOTAL_COUNT];
 };
@@ -30,6 +30,10 @@ SettingsManager::SettingsManager(QWidget* parent) :
    ui->featureSyncedRtc->setChecked(settings->value("featureSyncedRtc", false).toBool());
    ui->featureHleApis->setChecked(settings->value("featureHleApis", false).toBool());
    ui->featureDurable->setChecked(settings->value("featureDurable", false).toBool());
+   ui->featurePipelinedVideo->setChecked(settings->value("featurePipelinedVideo", false).toBool());
+#if !defined(EMU_MULTITHREADED)
+   ui->featurePipelinedVideo->hide();//without threads it only adds a frame of lag
+#endif
 
    setKeySelectorState(-1);
    updateButtonKeys();
@@ -153,6 +157,10 @@ void SettingsManager::on_featureDurable_toggled(bool checked){
    settings->setValue("featureDurable", checked);
 }
 
+void SettingsManager::on_featurePipelinedVideo_toggled(bool checked){
+   settings->setValue("featurePipelinedVideo", checked);
+}
+
 void SettingsManager::on_fastBoot_toggled(bool checked){
    settings->setValue("fastBoot", checked);
 }
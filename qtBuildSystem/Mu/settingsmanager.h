@@ -47,6 +47,7 @@ private slots:
    void on_featureSyncedRtc_toggled(bool checked);
    void on_featureHleApis_toggled(bool checked);
    void on_featureDurable_toggled(bool checked);
+   void on_featurePipelinedVideo_toggled(bool checked);
 
    void on_fastBoot_toggled(bool checked);
    void on_useOs5_toggled(bool checked);
@@ -15,14 +15,16 @@
 
 uint8_t     dbvzReg[DBVZ_REG_SIZE];
 dbvz_chip_t dbvzChipSelects[DBVZ_CHIP_END];
-double      dbvzSysclksPerClk32;//how many SYSCLK cycles before toggling the 32.768 kHz crystal
+uint32_t    dbvzSysclksPerClk32;//how many SYSCLK cycles before toggling the 32.768 kHz crystal, all SYSCLK counts are fixed point
 uint32_t    dbvzFrameClk32s;//how many CLK32s have happened in the current frame
-double      dbvzClk32Sysclks;//how many SYSCLKs have happened in the current CLK32
+uint32_t    dbvzClk32Sysclks;//how many SYSCLKs have happened in the current CLK32
 int8_t      pllSleepWait;
 int8_t      pllWakeWait;
 uint32_t    clk32Counter;
-double      pctlrCpuClockDivider;
-double      timerCycleCounter[2];
+uint32_t    cpuIdleClk32s;//CLK32s left to waste from CMD_IDLE_X_CLK32
+uint8_t     pctlrCpuClockDivider;//CPU speed in 31ths of SYSCLK
+uint32_t    timerCycleCounter[2];
+uint32_t    timerPrescalerCounter[2];//clocks since the timer last went up
 uint16_t    timerStatusReadAcknowledge[2];
 uint8_t     portDInterruptLastValue;//used for edge triggered interrupt timing
 uint16_t    spi1RxFifo[9];
@@ -37,20 +39,41 @@ uint8_t     pwm1Fifo[6];
 uint8_t     pwm1ReadPosition;
 uint8_t     pwm1WritePosition;
 
+static bool    cpuIdle;//the CPU is STOPed or stuck in an idle loop, it wont run again until the interrupt level changes
+static uint8_t cpuIntLevel;
+static bool    interruptLevelStale;//ISR, ILCR or PCTLR changed since checkInterrupts() last worked out the interrupt level
+static bool    cpuSliceRunning;//the CPU runs ahead of everything else until the next event, these say how far it is
+static uint32_t cpuSliceSysclks;
+static uint32_t cpuSliceSysclksDone;
+static uint32_t cpuSliceSpeed;
+static uint64_t sysclkTime;//SYSCLKs and CLK32s since reset, the timers only catch up to these when they have to
+static uint64_t clk32Time;
+static uint8_t  timerSource[2];//what moves each timer forward as a DBVZ_TIMER_REASON_*, DBVZ_TIMER_REASON_TIN if time passing doesnt
+static uint64_t timerSyncTime[2];//when TCN was last brought up to date, in clocks of the timers source
+static uint64_t timerEventTime[2];//when the timer will hit TCMP or wrap, UINT64_MAX if it doesnt count by itself
+static input_t  inputQueue[INPUT_QUEUE_SIZE];//the frontends input, only held between frames so it isnt in save states
+static uint32_t inputQueueClk32s[INPUT_QUEUE_SIZE];//the CLK32 of the frame each input is for
+static uint8_t  inputQueueReadPosition;
+static uint8_t  inputQueueWritePosition;
 
 static void checkInterrupts(void);
 static void checkPortDInterrupts(void);
 static void pllWakeCpuIfOff(void);
-static double sysclksPerClk32(void);
+static uint32_t sysclksPerClk32(void);
+static uint32_t cpuCyclesToSysclks(int32_t cycles, uint32_t cpuSpeed);
+static void timerSchedule(uint8_t timer);
+static void timerCatchUp(uint8_t timer);
+static uint16_t getTcn(uint8_t timer);
 static int32_t audioGetFramePercentIncrementFromClk32s(int32_t count);
-static int32_t audioGetFramePercentIncrementFromSysclks(double count);
+static int32_t audioGetFramePercentIncrementFromSysclks(uint32_t count);
 static int32_t audioGetFramePercentage(void);
+static bool dequeueInput(uint32_t clk32);
 
 #include "dbvzRegisterAccessors.c.h"
 #include "dbvzTiming.c.h"
 
 bool dbvzIsPllOn(void){
-   return !(dbvzSysclksPerClk32 < 1.0);
+   return !(dbvzSysclksPerClk32 < 1 << DBVZ_SYSCLK_FRACTION_BITS);
 }
 
 bool m515BacklightAmplifierState(void){
@@ -101,6 +124,38 @@ void m515RefreshInputState(void){
    checkPortDInterrupts();//this calls checkInterrupts() so it doesnt need to be called above
 }
 
+void dbvzQueueInput(input_t* input, uint32_t clk32){
+   uint8_t newest = (inputQueueWritePosition + INPUT_QUEUE_SIZE - 1) % INPUT_QUEUE_SIZE;
+
+   if(inputQueueReadPosition != inputQueueWritePosition){
+      //an input cant happen before the one queued ahead of it
+      clk32 = FAST_MAX(clk32, inputQueueClk32s[newest]);
+
+      //out of space, keep the newest state since that is what the frame has to end with
+      if((inputQueueWritePosition + 1) % INPUT_QUEUE_SIZE == inputQueueReadPosition){
+         inputQueue[newest] = *input;
+         return;
+      }
+   }
+
+   inputQueue[inputQueueWritePosition] = *input;
+   inputQueueClk32s[inputQueueWritePosition] = clk32;
+   inputQueueWritePosition = (inputQueueWritePosition + 1) % INPUT_QUEUE_SIZE;
+}
+
+static bool dequeueInput(uint32_t clk32){
+   //moves every queued input due by clk32 into palmInput, returns if there were any
+   bool dequeued = false;
+
+   while(inputQueueReadPosition != inputQueueWritePosition && inputQueueClk32s[inputQueueReadPosition] <= clk32){
+      palmInput = inputQueue[inputQueueReadPosition];
+      inputQueueReadPosition = (inputQueueReadPosition + 1) % INPUT_QUEUE_SIZE;
+      dequeued = true;
+   }
+
+   return dequeued;
+}
+
 int32_t interruptAcknowledge(int32_t intLevel){
    uint8_t vectorOffset = registerArrayRead8(IVR);
    int32_t vector;
@@ -150,7 +205,7 @@ static void pllWakeCpuIfOff(void){
       pllWakeWait = pllWaitTable[registerArrayRead16(PLLCR) & 0x0003];
 }
 
-static void checkInterrupts(void){
+static uint8_t getInterruptLevel(void){
    uint32_t activeInterrupts = registerArrayRead32(ISR);
    uint16_t interruptLevelControlRegister = registerArrayRead16(ILCR);
    uint8_t spi1IrqLevel = interruptLevelControlRegister >> 12;
@@ -194,14 +249,36 @@ static void checkInterrupts(void){
    if(intLevel < timer2IrqLevel && activeInterrupts & DBVZ_INT_TMR2)
       intLevel = timer2IrqLevel;
 
+   return intLevel;
+}
+
+static void checkInterrupts(void){
+   uint8_t intLevel;
+
+   //nothing that decides the level has changed
+   if(!interruptLevelStale)
+      return;
+
+   interruptLevelStale = false;
+   intLevel = getInterruptLevel();
+
    //even masked interrupts turn off PCTLR, 4.5.4 Power Control Register MC68VZ328UM.pdf
    if(intLevel > 0 && registerArrayRead8(PCTLR) & 0x80){
       registerArrayWrite8(PCTLR, registerArrayRead8(PCTLR) & 0x1F);
-      pctlrCpuClockDivider = 1.0;
+      pctlrCpuClockDivider = 31;
+
+      //the CPU was given cycles for the old speed
+      if(cpuSliceRunning)
+         flx68000EndTimeslice();
    }
 
-   //should be called even if intLevel is 0, that is how the interrupt state gets cleared
-   flx68000SetIrq(intLevel);
+   //an idle CPU may take the interrupt and do something else, a level of 0 is how the interrupt state gets cleared
+   if(intLevel != cpuIntLevel){
+      cpuIdle = false;
+      cpuIdleClk32s = 0;
+      cpuIntLevel = intLevel;
+      flx68000SetIrq(intLevel);
+   }
 }
 
 static void checkPortDInterrupts(void){
@@ -268,6 +345,115 @@ static void checkPortDInterrupts(void){
    checkInterrupts();
 }
 
+enum{
+   REGISTER_PLAIN_READ_8   = 0x01,
+   REGISTER_PLAIN_READ_16  = 0x02,
+   REGISTER_PLAIN_READ_32  = 0x04,
+   REGISTER_PLAIN_WRITE_8  = 0x08,
+   REGISTER_PLAIN_WRITE_16 = 0x10,
+   REGISTER_PLAIN_WRITE_32 = 0x20,
+   REGISTER_READ_ONLY_32   = 0x40
+};
+
+//how each register can be accessed without going through the switch, anything not marked here has side effects(FIFOs, write 1 to clear, chip select changes...) or is unemulated
+static uint8_t registerAccess[DBVZ_REG_SIZE];
+
+static const uint16_t plainRead8[] = {
+   //16 bit registers being read as 8 bit
+   SPICONT1, SPICONT1 + 1, SPIINTCS, SPIINTCS + 1,
+
+   //basic non GPIO functions
+   SCR, LCKCON, IVR, PWMP1,
+
+   //port d special functions
+   PDPOL, PDIRQEN, PDIRQEG, PDKBEN,
+
+   //I/O direction
+   PBDIR, PDDIR, PEDIR, PFDIR, PJDIR, PKDIR,
+
+   //select between GPIO or special function
+   //PGSEL and PMSEL lack the top 2 bits and PDSEL lacks the bottom 4 bits but that is handled on write
+   PBSEL, PCSEL, PDSEL, PESEL, PFSEL, PGSEL, PJSEL, PKSEL, PMSEL,
+
+   //pull up/down enable
+   //PGPUEN and PMPUEN lack the top 2 bits but that is handled on write
+   PAPUEN, PBPUEN, PCPDEN, PDPUEN, PEPUEN, PFPUEN, PGPUEN, PJPUEN, PKPUEN, PMPUEN
+};
+
+static const uint16_t plainRead16[] = {
+   //32 bit registers accessed as 16 bit
+   IDR, IDR + 2, IMR, IMR + 2, IPR, IPR + 2, ISR, ISR + 2,
+
+   CSA, CSB, CSC, CSD, CSGBA, CSGBB, CSGBC, CSGBD, CSUGBA,
+   PLLCR, DRAMC, SDCTRL,
+   RTCISR, RTCCTL, RTCIENR,
+   ILCR, ICR,
+   TCMP1, TCMP2, TPRER1, TPRER2, TCTL1, TCTL2,
+   SPICONT1, SPIINTCS, SPISPC, SPICONT2, SPIDATA2
+};
+
+static const uint16_t plainRead32[] = {
+   ISR, IPR, IMR, RTCTIME, IDR
+};
+
+static const uint16_t plainWrite8[] = {
+   //select between GPIO or special function
+   PCSEL, PESEL,
+
+   //direction select
+   PADIR, PCDIR, PDDIR, PEDIR,
+
+   //pull up/down enable
+   PAPUEN, PBPUEN, PCPDEN, PDPUEN, PEPUEN, PFPUEN, PJPUEN, PKPUEN,
+
+   //port data value, nothing known is attached to port
+   PCDATA, PEDATA, PFDATA,
+
+   //dragonball LCD controller, not attached to anything in Palm m515
+   LCKCON
+};
+
+static const uint16_t plainWrite16[] = {
+   //unemulated, address line remapping, too CPU intensive to emulate
+   DRAMMC,
+
+   SPISPC
+};
+
+static const uint16_t plainWrite32[] = {
+   LSSA
+};
+
+static const uint16_t readOnly32[] = {
+   IDR, IPR
+};
+
+static void markRegisters(const uint16_t* registers, uint32_t count, uint8_t access){
+   uint32_t index;
+
+   for(index = 0; index < count; index++)
+      registerAccess[registers[index]] |= access;
+}
+
+static void buildRegisterAccessTable(void){
+   uint32_t index;
+
+   memset(registerAccess, 0x00, sizeof(registerAccess));
+   markRegisters(plainRead8, sizeof(plainRead8) / sizeof(plainRead8[0]), REGISTER_PLAIN_READ_8);
+   markRegisters(plainRead16, sizeof(plainRead16) / sizeof(plainRead16[0]), REGISTER_PLAIN_READ_16);
+   markRegisters(plainRead32, sizeof(plainRead32) / sizeof(plainRead32[0]), REGISTER_PLAIN_READ_32);
+   markRegisters(plainWrite8, sizeof(plainWrite8) / sizeof(plainWrite8[0]), REGISTER_PLAIN_WRITE_8);
+   markRegisters(plainWrite16, sizeof(plainWrite16) / sizeof(plainWrite16[0]), REGISTER_PLAIN_WRITE_16);
+   markRegisters(plainWrite32, sizeof(plainWrite32) / sizeof(plainWrite32[0]), REGISTER_PLAIN_WRITE_32);
+   markRegisters(readOnly32, sizeof(readOnly32) / sizeof(readOnly32[0]), REGISTER_READ_ONLY_32);
+
+   //bootloader, 8 bit writes still go through the switch
+   for(index = 0xE00; index < DBVZ_REG_SIZE; index++)
+      registerAccess[index] |= REGISTER_PLAIN_READ_8 | REGISTER_PLAIN_READ_16 | REGISTER_PLAIN_READ_32;
+   for(index = 0xFC0; index < DBVZ_REG_SIZE; index++)
+      registerAccess[index] |= REGISTER_PLAIN_WRITE_16 | REGISTER_PLAIN_WRITE_32;
+}
+
 static void printHwRegAccess(uint32_t address, uint32_t value, uint32_t size, bool isWrite){
    if(isWrite)
       debugLog("CPU wrote %d bits of 0x%08X to register 0x%03X, PC:0x%08X.\n", size, value, address, flx68000GetPc());
@@ -285,6 +471,9 @@ uint8_t dbvzGetRegister8(uint32_t address){
 
    address &= 0x00000FFF;
 
+   if(registerAccess[address] & REGISTER_PLAIN_READ_8)
+      return registerArrayRead8(address);
+
    switch(address){
       case PADATA:
          return getPortAValue();
@@ -320,66 +509,12 @@ uint8_t dbvzGetRegister8(uint32_t address){
          debugLog("PWMCNT1 not implimented\n");
          return 0x00;
 
-      //16 bit registers being read as 8 bit
-      case SPICONT1:
-      case SPICONT1 + 1:
-      case SPIINTCS:
-      case SPIINTCS + 1:
       case PLLFSR:
+         return getPllfsr() >> 8;
       case PLLFSR + 1:
-
-      //basic non GPIO functions
-      case SCR:
-      case LCKCON:
-      case IVR:
-      case PWMP1:
-
-      //port d special functions
-      case PDPOL:
-      case PDIRQEN:
-      case PDIRQEG:
-      case PDKBEN:
-
-      //I/O direction
-      case PBDIR:
-      case PDDIR:
-      case PEDIR:
-      case PFDIR:
-      case PJDIR:
-      case PKDIR:
-
-      //select between GPIO or special function
-      case PBSEL:
-      case PCSEL:
-      case PDSEL:
-      case PESEL:
-      case PFSEL:
-      case PGSEL:
-      case PJSEL:
-      case PKSEL:
-      case PMSEL:
-
-      //pull up/down enable
-      case PAPUEN:
-      case PBPUEN:
-      case PCPDEN:
-      case PDPUEN:
-      case PEPUEN:
-      case PFPUEN:
-      case PGPUEN:
-      case PJPUEN:
-      case PKPUEN:
-      case PMPUEN:
-         //simple read, no actions needed
-         //PGPUEN, PGSEL PMSEL and PMPUEN lack the top 2 bits but that is handled on write
-         //PDSEL lacks the bottom 4 bits but that is handled on write
-         return registerArrayRead8(address);
+         return getPllfsr() & 0xFF;
 
       default:
-         //bootloader
-         if(address >= 0xE00)
-            return registerArrayRead8(address);
-
          printHwRegAccess(address, 0, 8, false);
          return 0x00;
    }
@@ -395,6 +530,9 @@ uint16_t dbvzGetRegister16(uint32_t address){
 
    address &= 0x00000FFF;
 
+   if(registerAccess[address] & REGISTER_PLAIN_READ_16)
+      return registerArrayRead16(address);
+
    switch(address){
       case TSTAT1:
          timerStatusReadAcknowledge[0] |= registerArrayRead16(TSTAT1);//active bits acknowledged
@@ -420,54 +558,13 @@ uint16_t dbvzGetRegister16(uint32_t address){
          }
 
       case PLLFSR:
-         return registerArrayRead16(PLLFSR);
+         return getPllfsr();
 
-      //32 bit registers accessed as 16 bit
-      case IDR:
-      case IDR + 2:
-      case IMR:
-      case IMR + 2:
-      case IPR:
-      case IPR + 2:
-      case ISR:
-      case ISR + 2:
-
-      case CSA:
-      case CSB:
-      case CSC:
-      case CSD:
-      case CSGBA:
-      case CSGBB:
-      case CSGBC:
-      case CSGBD:
-      case CSUGBA:
-      case PLLCR:
-      case DRAMC:
-      case SDCTRL:
-      case RTCISR:
-      case RTCCTL:
-      case RTCIENR:
-      case ILCR:
-      case ICR:
-      case TCMP1:
-      case TCMP2:
-      case TPRER1:
-      case TPRER2:
-      case TCTL1:
-      case TCTL2:
-      case SPICONT1:
-      case SPIINTCS:
-      case SPISPC:
-      case SPICONT2:
-      case SPIDATA2:
-         //simple read, no actions needed
-         return registerArrayRead16(address);
+      case TCN1:
+      case TCN2:
+         return getTcn(address == TCN1 ? 0 : 1);
 
       default:
-         //bootloader
-         if(address >= 0xE00)
-            return registerArrayRead16(address);
-
          printHwRegAccess(address, 0, 16, false);
          return 0x0000;
    }
@@ -483,23 +580,11 @@ uint32_t dbvzGetRegister32(uint32_t address){
 
    address &= 0x00000FFF;
 
-   switch(address){
-      case ISR:
-      case IPR:
-      case IMR:
-      case RTCTIME:
-      case IDR:
-         //simple read, no actions needed
-         return registerArrayRead32(address);
+   if(registerAccess[address] & REGISTER_PLAIN_READ_32)
+      return registerArrayRead32(address);
 
-      default:
-         //bootloader
-         if(address >= 0xE00)
-            return registerArrayRead32(address);
-
-         printHwRegAccess(address, 0, 32, false);
-         return 0x00000000;
-   }
+   printHwRegAccess(address, 0, 32, false);
+   return 0x00000000;
 }
 
 void dbvzSetRegister8(uint32_t address, uint8_t value){
@@ -512,6 +597,11 @@ void dbvzSetRegister8(uint32_t address, uint8_t value){
 
    address &= 0x00000FFF;
 
+   if(registerAccess[address] & REGISTER_PLAIN_WRITE_8){
+      registerArrayWrite8(address, value);
+      return;
+   }
+
    switch(address){
       case SCR:
          setScr(value);
@@ -530,9 +620,12 @@ void dbvzSetRegister8(uint32_t address, uint8_t value){
          return;
 
       case PCTLR:
+         dbvzSyncToCpu();
          registerArrayWrite8(address, value & 0x9F);
          if(value & 0x80)
-            pctlrCpuClockDivider = (value & 0x1F) / 31.0;
+            pctlrCpuClockDivider = value & 0x1F;
+         interruptLevelStale = true;//a pending interrupt turns it right back off
+         checkInterrupts();
          return;
 
       case IVR:
@@ -625,37 +718,6 @@ void dbvzSetRegister8(uint32_t address, uint8_t value){
          registerArrayWrite8(address, value & 0x3F);
          return;
 
-      //select between GPIO or special function
-      case PCSEL:
-      case PESEL:
-
-      //direction select
-      case PADIR:
-      case PCDIR:
-      case PDDIR:
-      case PEDIR:
-
-      //pull up/down enable
-      case PAPUEN:
-      case PBPUEN:
-      case PCPDEN:
-      case PDPUEN:
-      case PEPUEN:
-      case PFPUEN:
-      case PJPUEN:
-      case PKPUEN:
-
-      //port data value, nothing known is attached to port
-      case PCDATA:
-      case PEDATA:
-      case PFDATA:
-
-      //dragonball LCD controller, not attached to anything in Palm m515
-      case LCKCON:
-         //simple write, no actions needed
-         registerArrayWrite8(address, value);
-         return;
-
       default:
          //writeable bootloader region
          if(address >= 0xFC0){
@@ -678,13 +740,20 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
 
    address &= 0x00000FFF;
 
+   if(registerAccess[address] & REGISTER_PLAIN_WRITE_16){
+      registerArrayWrite16(address, value);
+      return;
+   }
+
    switch(address){
       case RTCIENR:
+         dbvzSyncToCpu();
          //missing bits 6 and 7
          registerArrayWrite16(address, value & 0xFF3F);
          return;
 
       case RTCCTL:
+         dbvzSyncToCpu();
          registerArrayWrite16(address, value & 0x00A0);
          return;
 
@@ -692,12 +761,14 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          //this is a 32 bit register but Palm OS writes to it as 16 bit chunks
          registerArrayWrite16(IMR, value & 0x00FF);
          registerArrayWrite16(ISR, registerArrayRead16(IPR) & ~registerArrayRead16(IMR));
+         interruptLevelStale = true;
          checkInterrupts();
          return;
       case IMR + 2:
          //this is a 32 bit register but Palm OS writes to it as 16 bit chunks
          registerArrayWrite16(IMR + 2, value & 0xFFFF);//Palm OS writes to reserved bits 14 and 15
          registerArrayWrite16(ISR + 2, registerArrayRead16(IPR + 2) & ~registerArrayRead16(IMR + 2));
+         interruptLevelStale = true;
          checkInterrupts();
          return;
 
@@ -710,7 +781,23 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
 
       case TCTL1:
       case TCTL2:
+         dbvzSyncToCpu();
+         timerCatchUp(address == TCTL1 ? 0 : 1);
+         //the prescaler counts something else now
+         if((registerArrayRead16(address) ^ value) & 0x000E)
+            timerPrescalerCounter[address == TCTL1 ? 0 : 1] = 0;
          registerArrayWrite16(address, value & 0x01FF);
+         timerSchedule(address == TCTL1 ? 0 : 1);
+         return;
+
+      case TCMP1:
+      case TCMP2:
+      case TPRER1:
+      case TPRER2:
+         dbvzSyncToCpu();
+         timerCatchUp(address == TCMP1 || address == TPRER1 ? 0 : 1);
+         registerArrayWrite16(address, value);
+         timerSchedule(address == TCMP1 || address == TPRER1 ? 0 : 1);
          return;
 
       case TSTAT1:
@@ -722,6 +809,7 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          return;
 
       case WATCHDOG:
+         dbvzSyncToCpu();
          //writing to the watchdog resets the counter bits(8 and 9) to 0
          //1 must be written to clear INTF
          registerArrayWrite16(WATCHDOG, (value & 0x0003) | (registerArrayRead16(WATCHDOG) & (~value & 0x0080)));
@@ -739,10 +827,12 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          return;
 
       case PLLFSR:
+         dbvzSyncToCpu();
          setPllfsr(value);
          return;
 
       case PLLCR:
+         dbvzSyncToCpu();
          //CLKEN is required for SED1376 operation
          registerArrayWrite16(PLLCR, value & 0x3FBB);
          dbvzSysclksPerClk32 = sysclksPerClk32();
@@ -772,11 +862,6 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          updateCsdAddressLines();//the EDO bit can disable SDRAM access
          return;
 
-      case DRAMMC:
-         //unemulated, address line remapping, too CPU intensive to emulate
-         registerArrayWrite16(address, value);
-         return;
-
       case SDCTRL:
          //missing bits 13, 9, 8 and 7
          //debugLog("Set SDCTRL, old value:0x%04X, new value:0x%04X, PC:0x%08X\n", registerArrayRead16(address), value, flx68000GetPc());
@@ -793,6 +878,8 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
             //only reset address space if size changed, enabled/disabled or exiting boot mode
             if((value & 0x000F) != (oldCsa & 0x000F) || dbvzChipSelects[DBVZ_CHIP_A0_ROM].inBootMode != oldBootMode)
                dbvzResetAddressSpace();
+            else if((value & 0x8000) != (oldCsa & 0x8000))
+               dbvzRefreshBankAccess();//protection changed
          }
          return;
 
@@ -804,6 +891,8 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
             //only reset address space if size changed or enabled/disabled
             if((value & 0x000F) != (oldCsb & 0x000F))
                dbvzResetAddressSpace();
+            else if((value & 0xF800) != (oldCsb & 0xF800))
+               dbvzRefreshBankAccess();//protection changed
          }
          return;
 
@@ -824,6 +913,8 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
             //only reset address space if size changed, enabled/disabled or DRAM bit changed
             if((value & 0x020F) != (oldCsd & 0x020F))
                dbvzResetAddressSpace();
+            else if((value & 0xF800) != (oldCsd & 0xF800))
+               dbvzRefreshBankAccess();//protection changed
          }
          return;
 
@@ -910,6 +1001,7 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          return;
 
       case PWMC1:
+         dbvzSyncToCpu();
          setPwmc1(value);
          return;
 
@@ -936,22 +1028,7 @@ void dbvzSetRegister16(uint32_t address, uint16_t value){
          registerArrayWrite16(NIPR1, value & 0x87FF);
          return;
 
-      case SPISPC:
-      case TCMP1:
-      case TCMP2:
-      case TPRER1:
-      case TPRER2:
-         //simple write, no actions needed
-         registerArrayWrite16(address, value);
-         return;
-
       default:
-         //writeable bootloader region
-         if(address >= 0xFC0){
-            registerArrayWrite16(address, value);
-            return;
-         }
-
          printHwRegAccess(address, value, 16, true);
          return;
    }
@@ -967,17 +1044,19 @@ void dbvzSetRegister32(uint32_t address, uint32_t value){
 
    address &= 0x00000FFF;
 
+   if(registerAccess[address] & (REGISTER_PLAIN_WRITE_32 | REGISTER_READ_ONLY_32)){
+      //writes to read only registers do nothing
+      if(registerAccess[address] & REGISTER_PLAIN_WRITE_32)
+         registerArrayWrite32(address, value);
+      return;
+   }
+
    switch(address){
       case RTCTIME:
       case RTCALRM:
          registerArrayWrite32(address, value & 0x1F3F003F);
          return;
 
-      case IDR:
-      case IPR:
-         //write to read only register, do nothing
-         return;
-
       case ISR:
          setIsr(value, true, true);
          return;
@@ -985,21 +1064,11 @@ void dbvzSetRegister32(uint32_t address, uint32_t value){
       case IMR:
          registerArrayWrite32(IMR, value & 0x00FFFFFF);//Palm OS writes to reserved bits 14 and 15
          registerArrayWrite32(ISR, registerArrayRead32(IPR) & ~registerArrayRead32(IMR));
+         interruptLevelStale = true;
          checkInterrupts();
          return;
 
-      case LSSA:
-         //simple write, no actions needed
-         registerArrayWrite32(address, value);
-         return;
-
       default:
-         //writeable bootloader region
-         if(address >= 0xFC0){
-            registerArrayWrite32(address, value);
-            return;
-         }
-
          printHwRegAccess(address, value, 32, true);
          return;
    }
@@ -1010,13 +1079,22 @@ void dbvzReset(void){
    uint16_t oldDayr = registerArrayRead16(DAYR);//preserve DAYR
 
    memset(dbvzReg, 0x00, DBVZ_REG_SIZE - DBVZ_BOOTLOADER_SIZE);
-   dbvzSysclksPerClk32 = 0.0;
+   buildRegisterAccessTable();
+   dbvzSysclksPerClk32 = 0;
    clk32Counter = 0;
-   pctlrCpuClockDivider = 1.0;
+   cpuIdleClk32s = 0;
+   cpuIdle = false;
+   cpuIntLevel = 0;
+   interruptLevelStale = true;
+   pctlrCpuClockDivider = 31;
    pllSleepWait = -1;
    pllWakeWait = -1;
-   timerCycleCounter[0] = 0.0;
-   timerCycleCounter[1] = 0.0;
+   timerCycleCounter[0] = 0;
+   timerCycleCounter[1] = 0;
+   timerPrescalerCounter[0] = 0;
+   timerPrescalerCounter[1] = 0;
+   sysclkTime = 0;
+   clk32Time = 0;
    timerStatusReadAcknowledge[0] = 0x0000;
    timerStatusReadAcknowledge[1] = 0x0000;
    portDInterruptLastValue = 0x00;
@@ -1121,6 +1199,8 @@ void dbvzReset(void){
    //timers
    registerArrayWrite16(TCMP1, 0xFFFF);
    registerArrayWrite16(TCMP2, 0xFFFF);
+   timerSchedule(0);
+   timerSchedule(1);
 
    //serial I/O
    registerArrayWrite16(UBAUD1, 0x0002);
@@ -1158,6 +1238,7 @@ void dbvzReset(void){
 
    dbvzResetAddressSpace();
    flx68000Reset();
+   flx68000SetIrq(0);//the CPU keeps its interrupt level through a reset, it has to match cpuIntLevel
 }
 
 void dbvzLoadBootloader(uint8_t* data, uint32_t size){
@@ -1190,11 +1271,13 @@ uint32_t dbvzStateSize(void){
    size += DBVZ_TOTAL_MEMORY_BANKS;
    size += sizeof(uint32_t) * 4 * DBVZ_CHIP_END;//chip select states
    size += sizeof(uint8_t) * 5 * DBVZ_CHIP_END;//chip select states
-   size += sizeof(uint64_t) * 5;//32.32 fixed point double, timerXCycleCounter and CPU cycle timers
+   size += sizeof(uint32_t) * 3;//dbvzSysclksPerClk32, palmCycleCounter and palmClockMultiplier
    size += sizeof(int8_t);//pllSleepWait
    size += sizeof(int8_t);//pllWakeWait
    size += sizeof(uint32_t);//clk32Counter
-   size += sizeof(uint64_t);//pctlrCpuClockDivider
+   size += sizeof(uint32_t);//cpuIdleClk32s
+   size += sizeof(uint8_t);//pctlrCpuClockDivider
+   size += sizeof(uint32_t) * 4;//timerCycleCounter and timerPrescalerCounter
    size += sizeof(uint16_t) * 2;//timerStatusReadAcknowledge
    size += sizeof(uint8_t);//portDInterruptLastValue
    size += sizeof(uint16_t) * 9;//RX 8 * 16 SPI1 FIFO, 1 index is for FIFO full
@@ -1213,6 +1296,10 @@ void dbvzSaveState(uint8_t* data){
    uint32_t offset = 0;
    uint8_t index;
 
+   //TCN is saved, not when the timers last caught up
+   timerCatchUp(0);
+   timerCatchUp(1);
+
    //CPU core
    flx68000SaveState(data + offset);
    offset += flx68000StateSize();
@@ -1245,24 +1332,30 @@ void dbvzSaveState(uint8_t* data){
    }
 
    //timing
-   writeStateValueDouble(data + offset, dbvzSysclksPerClk32);
-   offset += sizeof(uint64_t);
-   writeStateValueDouble(data + offset, palmCycleCounter);
-   offset += sizeof(uint64_t);
-   writeStateValueDouble(data + offset, palmClockMultiplier);
-   offset += sizeof(uint64_t);
+   writeStateValue32(data + offset, dbvzSysclksPerClk32);
+   offset += sizeof(uint32_t);
+   writeStateValue32(data + offset, palmCycleCounter);
+   offset += sizeof(uint32_t);
+   writeStateValue32(data + offset, palmClockMultiplier);
+   offset += sizeof(uint32_t);
    writeStateValue8(data + offset, pllSleepWait);
    offset += sizeof(int8_t);
    writeStateValue8(data + offset, pllWakeWait);
    offset += sizeof(int8_t);
    writeStateValue32(data + offset, clk32Counter);
    offset += sizeof(uint32_t);
-   writeStateValueDouble(data + offset, pctlrCpuClockDivider);
-   offset += sizeof(uint64_t);
-   writeStateValueDouble(data + offset, timerCycleCounter[0]);
-   offset += sizeof(uint64_t);
-   writeStateValueDouble(data + offset, timerCycleCounter[1]);
-   offset += sizeof(uint64_t);
+   writeStateValue32(data + offset, cpuIdleClk32s);
+   offset += sizeof(uint32_t);
+   writeStateValue8(data + offset, pctlrCpuClockDivider);
+   offset += sizeof(uint8_t);
+   writeStateValue32(data + offset, timerCycleCounter[0]);
+   offset += sizeof(uint32_t);
+   writeStateValue32(data + offset, timerCycleCounter[1]);
+   offset += sizeof(uint32_t);
+   writeStateValue32(data + offset, timerPrescalerCounter[0]);
+   offset += sizeof(uint32_t);
+   writeStateValue32(data + offset, timerPrescalerCounter[1]);
+   offset += sizeof(uint32_t);
    writeStateValue16(data + offset, timerStatusReadAcknowledge[0]);
    offset += sizeof(uint16_t);
    writeStateValue16(data + offset, timerStatusReadAcknowledge[1]);
@@ -1341,24 +1434,30 @@ void dbvzLoadState(uint8_t* data){
    }
 
    //timing
-   dbvzSysclksPerClk32 = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
-   palmCycleCounter = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
-   palmClockMultiplier = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
+   dbvzSysclksPerClk32 = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   palmCycleCounter = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   palmClockMultiplier = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
    pllSleepWait = readStateValue8(data + offset);
    offset += sizeof(int8_t);
    pllWakeWait = readStateValue8(data + offset);
    offset += sizeof(int8_t);
    clk32Counter = readStateValue32(data + offset);
    offset += sizeof(uint32_t);
-   pctlrCpuClockDivider = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
-   timerCycleCounter[0] = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
-   timerCycleCounter[1] = readStateValueDouble(data + offset);
-   offset += sizeof(uint64_t);
+   cpuIdleClk32s = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   pctlrCpuClockDivider = readStateValue8(data + offset);
+   offset += sizeof(uint8_t);
+   timerCycleCounter[0] = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   timerCycleCounter[1] = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   timerPrescalerCounter[0] = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
+   timerPrescalerCounter[1] = readStateValue32(data + offset);
+   offset += sizeof(uint32_t);
    timerStatusReadAcknowledge[0] = readStateValue16(data + offset);
    offset += sizeof(uint16_t);
    timerStatusReadAcknowledge[1] = readStateValue16(data + offset);
@@ -1402,44 +1501,85 @@ void dbvzLoadState(uint8_t* data){
 }
 
 void dbvzLoadStateFinished(void){
+   cpuIdle = false;
+   cpuIntLevel = getInterruptLevel();//the CPU state has the level it was last given
+   interruptLevelStale = false;
+   timerSchedule(0);
+   timerSchedule(1);
+   dbvzRefreshBankAccess();
    flx68000LoadStateFinished();
 }
 
+void dbvzIdleCpu(uint32_t clk32s){
+   cpuIdleClk32s = clk32s;
+   flx68000EndTimeslice();
+}
+
 void dbvzExecute(void){
    uint32_t samples;
 
    //I/O
-   m515RefreshInputState();
-
-   //CPU
    dbvzFrameClk32s = 0;
-   for(; palmCycleCounter < (double)M515_CRYSTAL_FREQUENCY / EMU_FPS; palmCycleCounter += 1.0){
-      uint8_t cpuTimeSegments;
-
-      dbvzBeginClk32();
+   dequeueInput(0);
+   m515RefreshInputState();
 
-      for(cpuTimeSegments = 0; cpuTimeSegments < 2; cpuTimeSegments++){
-         double cyclesRemaining = dbvzSysclksPerClk32 / 2.0;
+   //the host may have changed RAM since the last frame
+   cpuIdle = false;
 
-         while(cyclesRemaining >= 1.0){
-            double sysclks = FAST_MIN(cyclesRemaining, DBVZ_SYSCLK_PRECISION);
-            int32_t cpuCycles = sysclks * pctlrCpuClockDivider * palmClockMultiplier;
+   //CPU
+   while(palmCycleCounter < M515_CRYSTAL_FREQUENCY){
+      if(dbvzIsPllOn()){
+         //run the CPU until the next event, an idle CPU would just spin until then, only time needs to pass
+         uint32_t sysclks = sysclksToNextEvent();
+         uint32_t cpuSpeed = pctlrCpuClockDivider * palmClockMultiplier;
+         int32_t cpuCycles = sysclksToCpuCycles(sysclks, cpuSpeed);
+
+         if(cpuCycles > 0 && !cpuIdle && cpuIdleClk32s == 0){
+            uint32_t sysclksRun;
+
+            cpuSliceRunning = true;
+            cpuSliceSysclks = sysclks;
+            cpuSliceSysclksDone = 0;
+            cpuSliceSpeed = cpuSpeed;
+            sysclksRun = cpuCyclesToSysclks(flx68000Execute(cpuCycles), cpuSpeed);
+            cpuSliceRunning = false;
+
+            if(flx68000IsWaitingForInterrupt()){
+               cpuIdle = true;
+               sysclksRun = sysclks;
+            }
+            else if(flx68000IsSpinning()){
+               //polling hardware, skip to the next change of the PLLFSR CLK32 bit
+               uint32_t halfClk32 = dbvzSysclksPerClk32 / 2;
 
-            if(cpuCycles > 0)
-               flx68000Execute(cpuCycles);
-            dbvzAddSysclks(sysclks);
+               sysclksRun += halfClk32 - (dbvzClk32Sysclks + sysclksRun - cpuSliceSysclksDone) % halfClk32;
+            }
 
-            cyclesRemaining -= sysclks;
+            sysclks = FAST_MIN(sysclksRun, sysclks) - cpuSliceSysclksDone;
          }
 
-         //toggle CLK32 bit in PLLFSR, it indicates the current state of CLK32 so it must start false and be changed to true in the middle of CLK32
-         registerArrayWrite16(PLLFSR, registerArrayRead16(PLLFSR) ^ 0x8000);
+         addTime(sysclks);
+      }
+      else{
+         //the PLL is off, only CLK32 is running, jump straight to whatever can wake the CPU
+         uint32_t clk32sToWake = clk32sToNextWake();
+         uint32_t clk32sInFrame = clk32sLeftInFrame();
+
+         if(clk32sToWake > clk32sInFrame){
+            //nothing happens for the rest of the frame
+            skipClk32s(clk32sInFrame);
+         }
+         else{
+            skipClk32s(clk32sToWake - 1);
+            nextClk32();
+         }
       }
-
-      dbvzEndClk32();
-      dbvzFrameClk32s++;
    }
-   palmCycleCounter -= (double)M515_CRYSTAL_FREQUENCY / EMU_FPS;
+   palmCycleCounter -= M515_CRYSTAL_FREQUENCY;
+
+   //inputs queued for past the end of the frame, the CPU sees them next frame
+   if(dequeueInput(UINT32_MAX))
+      m515RefreshInputState();
 
    //audio
    blip_end_frame(palmAudioResampler, blip_clocks_needed(palmAudioResampler, AUDIO_SAMPLES_PER_FRAME));
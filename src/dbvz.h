@@ -33,6 +33,9 @@
 #define DBVZ_TIMER_REASON_TIN    0x01
 #define DBVZ_TIMER_REASON_CLK32  0x02
 
+//SYSCLKs are counted in 64ths, the PLL dividers cant split a CLK32 any finer so it is always a whole number of them
+#define DBVZ_SYSCLK_FRACTION_BITS 6
+
 //chip names
 enum{
    DBVZ_CHIP_BEGIN = 0,
@@ -66,14 +69,16 @@ typedef struct{
 //variables
 extern uint8_t     dbvzReg[];
 extern dbvz_chip_t dbvzChipSelects[];
-extern double      dbvzSysclksPerClk32;
+extern uint32_t    dbvzSysclksPerClk32;
 extern uint32_t    dbvzFrameClk32s;
-extern double      dbvzClk32Sysclks;
+extern uint32_t    dbvzClk32Sysclks;
 extern int8_t      pllSleepWait;
 extern int8_t      pllWakeWait;
 extern uint32_t    clk32Counter;
-extern double      pctlrCpuClockDivider;
-extern double      timerCycleCounter[];
+extern uint32_t    cpuIdleClk32s;
+extern uint8_t     pctlrCpuClockDivider;
+extern uint32_t    timerCycleCounter[];
+extern uint32_t    timerPrescalerCounter[];
 extern uint16_t    timerStatusReadAcknowledge[];
 extern uint8_t     portDInterruptLastValue;
 extern uint16_t    spi1RxFifo[];
@@ -91,7 +96,8 @@ extern uint8_t     pwm1WritePosition;
 //timing
 void dbvzBeginClk32(void);
 void dbvzEndClk32(void);
-void dbvzAddSysclks(double value);//only call between begin/endClk32
+void dbvzAddSysclks(uint32_t value);//only call between begin/endClk32
+void dbvzSyncToCpu(void);//call before changing anything that affects timing while the CPU is running
 
 //CPU
 bool dbvzIsPllOn(void);
@@ -101,6 +107,7 @@ bool sed1376ClockConnected(void);
 void ads7846OverridePenState(bool value);
 void m515RefreshTouchState(void);//just refreshes the touchscreen
 void m515RefreshInputState(void);//refreshes touchscreen, buttons and docked status
+void dbvzQueueInput(input_t* input, uint32_t clk32);//clk32 is when in the next frame it gets copied to palmInput
 //int32_t interruptAcknowledge(int32_t intLevel);//this is in m68kexternal.h
 
 //memory errors
@@ -125,6 +132,8 @@ void dbvzSaveState(uint8_t* data);
 void dbvzLoadState(uint8_t* data);
 void dbvzLoadStateFinished(void);
 
+void dbvzIdleCpu(uint32_t clk32s);//stops the CPU for clk32s CLK32s or until the interrupt level changes
+
 void dbvzExecute(void);
 
 #endif
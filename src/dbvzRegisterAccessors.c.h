@@ -21,14 +21,18 @@ static void registerArrayWrite32(uint32_t address, uint32_t value){M68K_BUFFER_W
 //interrupt setters, used for setting an interrupt with masking by IMR and logging in IPR
 static void setIprIsrBit(uint32_t interruptBit){
    uint32_t newIpr = registerArrayRead32(IPR) | interruptBit;
+   uint32_t newIsr = newIpr & ~registerArrayRead32(IMR);
    registerArrayWrite32(IPR, newIpr);
-   registerArrayWrite32(ISR, newIpr & ~registerArrayRead32(IMR));
+   interruptLevelStale |= newIsr != registerArrayRead32(ISR);
+   registerArrayWrite32(ISR, newIsr);
 }
 
 static void clearIprIsrBit(uint32_t interruptBit){
    uint32_t newIpr = registerArrayRead32(IPR) & ~interruptBit;
+   uint32_t newIsr = newIpr & ~registerArrayRead32(IMR);
    registerArrayWrite32(IPR, newIpr);
-   registerArrayWrite32(ISR, newIpr & ~registerArrayRead32(IMR));
+   interruptLevelStale |= newIsr != registerArrayRead32(ISR);
+   registerArrayWrite32(ISR, newIsr);
 }
 
 //SPI1 FIFO accessors
@@ -255,6 +259,7 @@ static void setCsgbd(uint16_t value){
 static void updateCsdAddressLines(void){
    uint16_t dramc = registerArrayRead16(DRAMC);
    uint16_t sdctrl = registerArrayRead16(SDCTRL);
+   uint32_t oldMask = dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask;
 
    if(registerArrayRead16(CSD) & 0x0200 && sdctrl & 0x8000 && dramc & 0x8000 && !(dramc & 0x0400)){
       //this register can remap address lines, that behavior is way too CPU intensive and complicated so only the "memory testing" and "correct" behavior is being emulated
@@ -272,6 +277,12 @@ static void updateCsdAddressLines(void){
       //RAM is not enabled properly
       dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask = 0x00000000;
    }
+
+   //the bank types stay the same but the RAM behind them moved
+   if(dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask != oldMask){
+      dbvzRefreshBankAccess();
+      flx68000FlushPredecodeCache();
+   }
 }
 
 static void setPllfsr(uint16_t value){
@@ -279,11 +290,29 @@ static void setPllfsr(uint16_t value){
 
    //change frequency if frequency protect bit isnt set
    if(!(oldPllfsr & 0x4000)){
-      registerArrayWrite16(PLLFSR, (value & 0x4CFF) | (oldPllfsr & 0x8000));//preserve CLK32 bit
+      registerArrayWrite16(PLLFSR, value & 0x4CFF);//the CLK32 bit is worked out when read
       dbvzSysclksPerClk32 = sysclksPerClk32();
    }
 }
 
+static uint16_t getPllfsr(void){
+   uint16_t pllfsr = registerArrayRead16(PLLFSR) & 0x7FFF;
+
+   //CLK32 bit, it indicates the current state of CLK32 so it must be false for the first half of CLK32 and true for the second
+   if(dbvzIsPllOn()){
+      uint32_t sysclks = dbvzClk32Sysclks;
+
+      //the CPU may be past the last time the timers where updated
+      if(cpuSliceRunning)
+         sysclks += FAST_MIN(cpuCyclesToSysclks(flx68000CyclesRun(), cpuSliceSpeed), cpuSliceSysclks) - cpuSliceSysclksDone;
+
+      if(sysclks % dbvzSysclksPerClk32 >= dbvzSysclksPerClk32 / 2)
+         pllfsr |= 0x8000;
+   }
+
+   return pllfsr;
+}
+
 static void setScr(uint8_t value){
    uint8_t oldScr = registerArrayRead8(SCR);
    uint8_t newScr = value & 0x1F;
@@ -334,6 +363,8 @@ static void setIlcr(uint16_t value){
       newIlcr |= oldIlcr & 0x0007;
 
    registerArrayWrite16(ILCR, newIlcr);
+   interruptLevelStale = true;
+   checkInterrupts();
 }
 
 static void setSpiIntCs(uint16_t value){
@@ -381,33 +412,28 @@ static void setSpiCont1(uint16_t value){
 
    //do a transfer if enabled(this register write and last) and exchange set
    if(value & oldSpiCont1 & 0x0200 && value & 0x0100){
-      while(spi1TxFifoEntrys() > 0){
-         uint16_t currentTxFifoEntry = spi1TxFifoRead();
-         uint16_t newRxFifoEntry;// = 0x0000;
-         uint8_t bitCount = (value & 0x000F) + 1;
-         //uint16_t startBit = 1 << (bitCount - 1);
-         //uint8_t bits;
+      //the whole TX FIFO is sent to the SD card as one burst
+      uint16_t txWords[8];
+      uint16_t rxWords[8];
+      uint8_t count = 0;
+      uint8_t index;
 
-         //debugLog("SPI1 transfer, bitCount:%d, PC:0x%08X\n", bitCount, flx68000GetPc());
+      while(spi1TxFifoEntrys() > 0)
+         txWords[count++] = spi1TxFifoRead();
 
-         //The most significant bit is output when the CPU loads the transmitted data, 13.2.3 SPI 1 Phase and Polarity Configurations MC68VZ328UM.pdf
-         /*
-         for(bits = 0; bits < bitCount; bits++){
-            newRxFifoEntry <<= 1;
-            newRxFifoEntry |= sdCardExchangeBit(!!(currentTxFifoEntry & startBit));
-            currentTxFifoEntry <<= 1;
-         }
-         */
-         newRxFifoEntry = sdCardExchangeXBitsOptimized(currentTxFifoEntry, bitCount);
+      //debugLog("SPI1 transfer, bitCount:%d, words:%d, PC:0x%08X\n", (value & 0x000F) + 1, count, flx68000GetPc());
 
-         //add received data back to RX FIFO
-         spi1RxFifoWrite(newRxFifoEntry);
+      //The most significant bit is output when the CPU loads the transmitted data, 13.2.3 SPI 1 Phase and Polarity Configurations MC68VZ328UM.pdf
+      sdCardExchangeXBitsBurst(txWords, rxWords, count, (value & 0x000F) + 1);
 
-         //overflow occured, remove 1 FIFO entry
-         //I do not currently know if the FIFO entry is removed from the back or front of the FIFO, going with the back for now
-         //if(spi1RxFifoEntrys() == 0)
-         //   spi1RxFifoRead();
-      }
+      //add received data back to RX FIFO
+      for(index = 0; index < count; index++)
+         spi1RxFifoWrite(rxWords[index]);
+
+      //overflow occured, remove 1 FIFO entry
+      //I do not currently know if the FIFO entry is removed from the back or front of the FIFO, going with the back for now
+      //if(spi1RxFifoEntrys() == 0)
+      //   spi1RxFifoRead();
    }
 
    //update SPIINTCS interrupt bits
@@ -576,6 +602,7 @@ static void setIsr(uint32_t value, bool useTopWord, bool useBottomWord){
       registerArrayWrite16(ISR + 2, registerArrayRead16(ISR + 2) & ~(value & 0xFFFF & portDEdgeSelect << 8));
    }
 
+   interruptLevelStale = true;
    checkInterrupts();
 }
 
@@ -689,7 +716,7 @@ static uint8_t getPortMValue(void){
    return ((registerArrayRead8(PMDATA) & registerArrayRead8(PMDIR)) | (~registerArrayRead8(PMDIR) & 0x20)) & registerArrayRead8(PMSEL);
 }
 
-static void samplePwm1(bool forClk32, double sysclks){
+static void samplePwm1(bool forClk32, uint32_t sysclks){
    uint16_t pwmc1 = registerArrayRead16(PWMC1);
 
    //validate clock mode
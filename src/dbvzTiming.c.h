@@ -1,12 +1,12 @@
 //both timer functions can call eachother define them here
-static void timer1(uint8_t reason, double sysclk);
-static void timer2(uint8_t reason, double sysclk);
+static void timer1(uint8_t reason, uint64_t clocks);
+static void timer2(uint8_t reason, uint64_t clocks);
 
-static void timer1(uint8_t reason, double sysclks){
+static void timer1(uint8_t reason, uint64_t clocks){
    uint16_t timer1Control = registerArrayRead16(TCTL1);
    uint16_t timer1Compare = registerArrayRead16(TCMP1);
-   double timer1OldCount = timerCycleCounter[0];
-   double timer1Prescaler = (registerArrayRead16(TPRER1) & 0x00FF) + 1;
+   uint32_t timer1OldCount = timerCycleCounter[0];
+   uint32_t timer1Prescaler = (registerArrayRead16(TPRER1) & 0x00FF) + 1;
    bool timer1Enabled = timer1Control & 0x0001;
 
    if(timer1Enabled){
@@ -18,28 +18,30 @@ static void timer1(uint8_t reason, double sysclks){
          case 0x0001://SYSCLK / timer prescaler
             if(reason != DBVZ_TIMER_REASON_SYSCLK)
                return;
-            timerCycleCounter[0] += sysclks / timer1Prescaler;
+            timer1Prescaler <<= DBVZ_SYSCLK_FRACTION_BITS;
             break;
 
          case 0x0002://SYSCLK / 16 / timer prescaler
             if(reason != DBVZ_TIMER_REASON_SYSCLK)
                return;
-            timerCycleCounter[0] += sysclks / 16.0 / timer1Prescaler;
+            timer1Prescaler <<= DBVZ_SYSCLK_FRACTION_BITS + 4;
             break;
 
          case 0x0003://TIN/TOUT pin / timer prescaler, the other timer can be attached to TIN/TOUT
             if(reason != DBVZ_TIMER_REASON_TIN)
                return;
-            timerCycleCounter[0] += 1.0 / timer1Prescaler;
             break;
 
          default://CLK32 / timer prescaler
             if(reason != DBVZ_TIMER_REASON_CLK32)
                return;
-            timerCycleCounter[0] += 1.0 / timer1Prescaler;
             break;
       }
 
+      clocks += timerPrescalerCounter[0];
+      timerCycleCounter[0] += clocks / timer1Prescaler;
+      timerPrescalerCounter[0] = clocks % timer1Prescaler;
+
       if(timer1OldCount < timer1Compare && timerCycleCounter[0] >= timer1Compare){
          //the comparison against the old value is to prevent an interrupt on every increment in free running mode
          //the timer is not cycle accurate and may not hit the value in the compare register perfectly so check if it would have during in the emulated time
@@ -56,7 +58,7 @@ static void timer1(uint8_t reason, double sysclks){
 
          //increment other timer if enabled
          if(pcrTinToutConfig == 0x03)
-            timer2(DBVZ_TIMER_REASON_TIN, 0);
+            timer2(DBVZ_TIMER_REASON_TIN, 1);
 
          //not free running, reset to 0, to prevent loss of ticks after compare event just subtract timerXCompare
          if(!(timer1Control & 0x0100))
@@ -64,16 +66,16 @@ static void timer1(uint8_t reason, double sysclks){
       }
 
       if(timerCycleCounter[0] > 0xFFFF)
-         timerCycleCounter[0] -= 0xFFFF;
+         timerCycleCounter[0] -= 0x10000;
       registerArrayWrite16(TCN1, (uint16_t)timerCycleCounter[0]);
    }
 }
 
-static void timer2(uint8_t reason, double sysclks){
+static void timer2(uint8_t reason, uint64_t clocks){
    uint16_t timer2Control = registerArrayRead16(TCTL2);
    uint16_t timer2Compare = registerArrayRead16(TCMP2);
-   double timer2OldCount = timerCycleCounter[1];
-   double timer2Prescaler = (registerArrayRead16(TPRER2) & 0x00FF) + 1;
+   uint32_t timer2OldCount = timerCycleCounter[1];
+   uint32_t timer2Prescaler = (registerArrayRead16(TPRER2) & 0x00FF) + 1;
    bool timer2Enabled = timer2Control & 0x0001;
 
    if(timer2Enabled){
@@ -85,28 +87,30 @@ static void timer2(uint8_t reason, double sysclks){
          case 0x0001://SYSCLK / timer prescaler
             if(reason != DBVZ_TIMER_REASON_SYSCLK)
                return;
-            timerCycleCounter[1] += sysclks / timer2Prescaler;
+            timer2Prescaler <<= DBVZ_SYSCLK_FRACTION_BITS;
             break;
 
          case 0x0002://SYSCLK / 16 / timer prescaler
             if(reason != DBVZ_TIMER_REASON_SYSCLK)
                return;
-            timerCycleCounter[1] += sysclks / 16.0 / timer2Prescaler;
+            timer2Prescaler <<= DBVZ_SYSCLK_FRACTION_BITS + 4;
             break;
 
          case 0x0003://TIN/TOUT pin / timer prescaler, the other timer can be attached to TIN/TOUT
             if(reason != DBVZ_TIMER_REASON_TIN)
                return;
-            timerCycleCounter[1] += 1.0 / timer2Prescaler;
             break;
 
          default://CLK32 / timer prescaler
             if(reason != DBVZ_TIMER_REASON_CLK32)
                return;
-            timerCycleCounter[1] += 1.0 / timer2Prescaler;
             break;
       }
 
+      clocks += timerPrescalerCounter[1];
+      timerCycleCounter[1] += clocks / timer2Prescaler;
+      timerPrescalerCounter[1] = clocks % timer2Prescaler;
+
       if(timer2OldCount < timer2Compare && timerCycleCounter[1] >= timer2Compare){
          //the comparison against the old value is to prevent an interrupt on every increment in free running mode
          //the timer is not cycle accurate and may not hit the value in the compare register perfectly so check if it would have during in the emulated time
@@ -123,7 +127,7 @@ static void timer2(uint8_t reason, double sysclks){
 
          //increment other timer if enabled
          if(pcrTinToutConfig == 0x02)
-            timer1(DBVZ_TIMER_REASON_TIN, 0);
+            timer1(DBVZ_TIMER_REASON_TIN, 1);
 
          //not free running, reset to 0, to prevent loss of ticks after compare event just subtract timerXCompare
          if(!(timer2Control & 0x0100))
@@ -131,30 +135,122 @@ static void timer2(uint8_t reason, double sysclks){
       }
 
       if(timerCycleCounter[1] > 0xFFFF)
-         timerCycleCounter[1] -= 0xFFFF;
+         timerCycleCounter[1] -= 0x10000;
       registerArrayWrite16(TCN2, (uint16_t)timerCycleCounter[1]);
    }
 }
 
-static double dmaclksPerClk32(void){
+static uint64_t timerClocksToEvent(uint8_t timer){
+   //how many clocks from its source the timer needs to hit TCMP or wrap, SYSCLKs are fixed point
+   uint16_t timerControl = registerArrayRead16(timer == 0 ? TCTL1 : TCTL2);
+   uint16_t timerCompare = registerArrayRead16(timer == 0 ? TCMP1 : TCMP2);
+   uint64_t timerPrescaler = (registerArrayRead16(timer == 0 ? TPRER1 : TPRER2) & 0x00FF) + 1;
+   uint32_t ticks = timerCycleCounter[timer] < timerCompare ? timerCompare - timerCycleCounter[timer] : 0x10000 - timerCycleCounter[timer];
+
+   switch((timerControl & 0x000E) >> 1){
+      case 0x0001://SYSCLK / timer prescaler
+         timerPrescaler <<= DBVZ_SYSCLK_FRACTION_BITS;
+         break;
+
+      case 0x0002://SYSCLK / 16 / timer prescaler
+         timerPrescaler <<= DBVZ_SYSCLK_FRACTION_BITS + 4;
+         break;
+   }
+
+   return ticks * timerPrescaler - timerPrescalerCounter[timer];
+}
+
+static uint8_t timerSourceReason(uint8_t timer){
+   //stopped timers and ones counting TIN are only moved forward by the other timer, never by time passing
+   uint16_t timerControl = registerArrayRead16(timer == 0 ? TCTL1 : TCTL2);
+   uint8_t timerSource = (timerControl & 0x000E) >> 1;
+
+   if(!(timerControl & 0x0001) || timerSource == 0x0000 || timerSource == 0x0003)
+      return DBVZ_TIMER_REASON_TIN;
+   return timerSource >= 0x0004 ? DBVZ_TIMER_REASON_CLK32 : DBVZ_TIMER_REASON_SYSCLK;
+}
+
+static uint64_t timerNow(uint8_t reason){
+   return reason == DBVZ_TIMER_REASON_SYSCLK ? sysclkTime : clk32Time;
+}
+
+static void timerSchedule(uint8_t timer){
+   //call once TCN is up to date, or after anything that changes how the timer counts
+   timerSource[timer] = timerSourceReason(timer);
+   timerSyncTime[timer] = timerNow(timerSource[timer]);
+   timerEventTime[timer] = timerSource[timer] != DBVZ_TIMER_REASON_TIN ? timerSyncTime[timer] + timerClocksToEvent(timer) : UINT64_MAX;
+}
+
+static void timerCatchUp(uint8_t timer){
+   //the timer is never left behind past its next event, so this can hit TCMP at most once
+   if(timerSource[timer] != DBVZ_TIMER_REASON_TIN){
+      uint64_t clocks = timerNow(timerSource[timer]) - timerSyncTime[timer];
+
+      if(timer == 0)
+         timer1(timerSource[timer], clocks);
+      else
+         timer2(timerSource[timer], clocks);
+   }
+
+   timerSchedule(timer);
+}
+
+static void timersCheckEvents(uint8_t reason){
+   uint8_t timer;
+
+   for(timer = 0; timer < 2; timer++)
+      if(timerSource[timer] == reason && timerNow(reason) >= timerEventTime[timer])
+         timerCatchUp(timer);
+}
+
+static uint16_t getTcn(uint8_t timer){
+   //TCN is only brought up to date at events, work out where it is now without moving the timer
+   uint64_t clocks;
+   uint64_t timerPrescaler;
+
+   if(timerSource[timer] == DBVZ_TIMER_REASON_TIN)
+      return timerCycleCounter[timer];
+
+   clocks = timerNow(timerSource[timer]) - timerSyncTime[timer];
+
+   //the CPU may be past the last time the timers where updated
+   if(cpuSliceRunning){
+      uint32_t sysclks = FAST_MIN(cpuCyclesToSysclks(flx68000CyclesRun(), cpuSliceSpeed), cpuSliceSysclks) - cpuSliceSysclksDone;
+
+      if(timerSource[timer] == DBVZ_TIMER_REASON_SYSCLK)
+         clocks += sysclks;
+      else if(dbvzIsPllOn())
+         clocks += (dbvzClk32Sysclks + sysclks) / dbvzSysclksPerClk32;
+   }
+   clocks = FAST_MIN(clocks, timerEventTime[timer] - timerSyncTime[timer]);
+
+   timerPrescaler = (registerArrayRead16(timer == 0 ? TPRER1 : TPRER2) & 0x00FF) + 1;
+   if(timerSource[timer] == DBVZ_TIMER_REASON_SYSCLK)
+      timerPrescaler <<= DBVZ_SYSCLK_FRACTION_BITS + ((registerArrayRead16(timer == 0 ? TCTL1 : TCTL2) & 0x000E) >> 1 == 0x0002 ? 4 : 0);
+
+   return timerCycleCounter[timer] + (timerPrescalerCounter[timer] + clocks) / timerPrescaler;
+}
+
+static uint32_t dmaclksPerClk32(void){
+   //fixed point like SYSCLKs, the dividers below can never make it lose bits
    uint16_t pllcr = registerArrayRead16(PLLCR);
    uint16_t pllfsr = registerArrayRead16(PLLFSR);
    uint8_t p = pllfsr & 0x00FF;
    uint8_t q = pllfsr >> 8 & 0x000F;
-   double dmaclks = 2.0 * (14.0 * (p + 1.0) + q + 1.0);
+   uint32_t dmaclks = 2 * (14 * (p + 1) + q + 1) << DBVZ_SYSCLK_FRACTION_BITS;
 
    //prescaler 1 enabled, divide by 2
    if(pllcr & 0x0080)
-      dmaclks /= 2.0;
+      dmaclks >>= 1;
 
    //prescaler 2 enabled, divides value from prescaler 1 by 2
    if(pllcr & 0x0020)
-      dmaclks /= 2.0;
+      dmaclks >>= 1;
 
    return dmaclks;
 }
 
-static double sysclksPerClk32(void){
+static uint32_t sysclksPerClk32(void){
    uint8_t sysclkSelect = registerArrayRead16(PLLCR) >> 8 & 0x0007;
 
    //>= 4 means run at full speed, no divider
@@ -162,7 +258,7 @@ static double sysclksPerClk32(void){
       return dmaclksPerClk32();
 
    //divide DMACLK by 2 to the power of PLLCR SYSCLKSEL
-   return dmaclksPerClk32() / (2 << sysclkSelect);
+   return dmaclksPerClk32() >> (sysclkSelect + 1);
 }
 
 static void rtiInterruptClk32(void){
@@ -359,7 +455,13 @@ static void rtcAddSecondClk32(void){
 }
 
 void dbvzBeginClk32(void){
-   dbvzClk32Sysclks = 0.0;
+   dbvzClk32Sysclks = 0;
+
+   //input the frontend queued for this point in the frame, the CPU may be waiting on it by polling
+   if(dequeueInput(dbvzFrameClk32s)){
+      cpuIdle = false;
+      m515RefreshInputState();
+   }
 }
 
 void dbvzEndClk32(void){
@@ -376,15 +478,15 @@ void dbvzEndClk32(void){
    if(registerArrayRead16(RTCCTL) & 0x0080 || registerArrayRead16(WATCHDOG) & 0x01)
       rtiInterruptClk32();
 
-   timer1(DBVZ_TIMER_REASON_CLK32, 0);
-   timer2(DBVZ_TIMER_REASON_CLK32, 0);
-   samplePwm1(true/*forClk32*/, 0.0);
+   clk32Time++;
+   timersCheckEvents(DBVZ_TIMER_REASON_CLK32);
+   samplePwm1(true/*forClk32*/, 0);
 
    //PLLCR sleep wait
    if(pllSleepWait != -1){
       if(pllSleepWait == 0){
          //disable PLL and CPU
-         dbvzSysclksPerClk32 = 0.0;
+         dbvzSysclksPerClk32 = 0;
          debugLog("PLL disabled, CPU is off!\n");
       }
       pllSleepWait--;
@@ -404,21 +506,177 @@ void dbvzEndClk32(void){
    checkInterrupts();
 }
 
-void dbvzAddSysclks(double count){
-   timer1(DBVZ_TIMER_REASON_SYSCLK, count);
-   timer2(DBVZ_TIMER_REASON_SYSCLK, count);
+void dbvzAddSysclks(uint32_t count){
+   sysclkTime += count;
+   timersCheckEvents(DBVZ_TIMER_REASON_SYSCLK);
    samplePwm1(false/*forClk32*/, count);
 
    checkInterrupts();
    dbvzClk32Sysclks += count;
 }
 
+static uint32_t sysclksLeftInClk32(void){
+   //the PLL may have been slowed down after the current CLK32 already had more SYSCLKs then it now needs
+   return dbvzClk32Sysclks < dbvzSysclksPerClk32 ? dbvzSysclksPerClk32 - dbvzClk32Sysclks : 0;
+}
+
+static int32_t sysclksToCpuCycles(uint32_t sysclks, uint32_t cpuSpeed){
+   //cpuSpeed is PCTLR 31ths multiplied by palmClockMultiplier
+   return (uint64_t)sysclks * cpuSpeed / (31 << (16 + DBVZ_SYSCLK_FRACTION_BITS));
+}
+
+static uint32_t cpuCyclesToSysclks(int32_t cycles, uint32_t cpuSpeed){
+   return (uint64_t)cycles * (31 << (16 + DBVZ_SYSCLK_FRACTION_BITS)) / cpuSpeed;
+}
+
+static uint32_t clk32sLeftInFrame(void){
+   return palmCycleCounter < M515_CRYSTAL_FREQUENCY ? (M515_CRYSTAL_FREQUENCY - palmCycleCounter + EMU_FPS - 1) / EMU_FPS : 0;
+}
+
+static uint32_t clk32sToNextWake(void){
+   //how many CLK32s can end before dbvzEndClk32() has something to do, the last one is the one that needs it, ignores the end of the frame
+   uint16_t rtiEnabled = registerArrayRead16(RTCIENR) & 0xFF00;
+   uint32_t clk32s = M515_CRYSTAL_FREQUENCY - clk32Counter;//RTC second and watchdog
+   uint8_t timer;
+
+   //RTI, only the fastest enabled one matters
+   if(rtiEnabled && (registerArrayRead16(RTCCTL) & 0x0080 || registerArrayRead16(WATCHDOG) & 0x01)){
+      uint32_t rtiPeriod = M515_CRYSTAL_FREQUENCY / 512;
+      uint16_t rtiBit = 0x8000;
+
+      while(!(rtiEnabled & rtiBit)){
+         rtiBit >>= 1;
+         rtiPeriod <<= 1;
+      }
+      clk32s = FAST_MIN(clk32s, rtiPeriod - clk32Counter % rtiPeriod);
+   }
+
+   //timers running from CLK32
+   for(timer = 0; timer < 2; timer++)
+      if(timerSource[timer] == DBVZ_TIMER_REASON_CLK32)
+         clk32s = FAST_MIN(clk32s, timerEventTime[timer] - clk32Time);
+
+   //PLL waits
+   if(pllSleepWait != -1)
+      clk32s = FAST_MIN(clk32s, (uint32_t)pllSleepWait + 1);
+   if(pllWakeWait != -1)
+      clk32s = FAST_MIN(clk32s, (uint32_t)pllWakeWait + 1);
+
+   //PWM1 is sampled every CLK32
+   if(registerArrayRead16(PWMC1) & 0x0010)
+      clk32s = 1;
+
+   //CMD_IDLE_X_CLK32 ending
+   if(cpuIdleClk32s > 0)
+      clk32s = FAST_MIN(clk32s, cpuIdleClk32s);
+
+   //next queued input
+   if(inputQueueReadPosition != inputQueueWritePosition && inputQueueClk32s[inputQueueReadPosition] > dbvzFrameClk32s)
+      clk32s = FAST_MIN(clk32s, inputQueueClk32s[inputQueueReadPosition] - dbvzFrameClk32s);
+
+   return FAST_MAX(clk32s, 1);
+}
+
+static uint32_t clk32sToNextEvent(void){
+   //the same as clk32sToNextWake() but stops at the end of the frame too
+   uint32_t clk32sToWake = clk32sToNextWake();
+   uint32_t clk32s = FAST_MIN(clk32sToWake, clk32sLeftInFrame());
+
+   return FAST_MAX(clk32s, 1);
+}
+
+static uint32_t sysclksToNextEvent(void){
+   //how many SYSCLKs the CPU can run before something needs to be checked
+   uint32_t sysclks = sysclksLeftInClk32() + (clk32sToNextEvent() - 1) * dbvzSysclksPerClk32;
+   uint8_t timer;
+
+   //timers running from SYSCLK
+   for(timer = 0; timer < 2; timer++)
+      if(timerSource[timer] == DBVZ_TIMER_REASON_SYSCLK)
+         sysclks = FAST_MIN(sysclks, timerEventTime[timer] - sysclkTime);
+
+   //PWM1 was always sampled in 2 halfs of a CLK32, keep it that way
+   if(registerArrayRead16(PWMC1) & 0x0010 && dbvzClk32Sysclks < dbvzSysclksPerClk32 / 2)
+      sysclks = FAST_MIN(sysclks, dbvzSysclksPerClk32 / 2 - dbvzClk32Sysclks);
+
+   return sysclks;
+}
+
+static void nextClk32(void){
+   dbvzEndClk32();
+   dbvzFrameClk32s++;
+   palmCycleCounter += EMU_FPS;
+   if(cpuIdleClk32s > 0)
+      cpuIdleClk32s--;
+   dbvzBeginClk32();
+}
+
+static void skipClk32s(uint32_t count){
+   //the same as count calls to nextClk32() when clk32sToNextEvent() says none of them have anything to do
+   clk32Counter += count;
+   clk32Time += count;
+   timersCheckEvents(DBVZ_TIMER_REASON_CLK32);
+   if(pllSleepWait != -1)
+      pllSleepWait -= count;
+   if(pllWakeWait != -1)
+      pllWakeWait -= count;
+   checkInterrupts();
+
+   dbvzFrameClk32s += count;
+   palmCycleCounter += count * EMU_FPS;
+   cpuIdleClk32s -= FAST_MIN(cpuIdleClk32s, count);
+   dbvzBeginClk32();
+}
+
+static void addTime(uint32_t sysclks){
+   //moves everything but the CPU forward, quiet CLK32s are skipped together
+   while(dbvzIsPllOn()){
+      uint32_t sysclksToClk32 = sysclksLeftInClk32();
+      uint32_t quietClk32s;
+
+      if(sysclks < sysclksToClk32){
+         if(sysclks > 0)
+            dbvzAddSysclks(sysclks);
+         return;
+      }
+
+      quietClk32s = FAST_MIN(clk32sToNextEvent() - 1, 1 + (sysclks - sysclksToClk32) / dbvzSysclksPerClk32);
+      if(quietClk32s > 0){
+         uint32_t quietSysclks = sysclksToClk32 + (quietClk32s - 1) * dbvzSysclksPerClk32;
+
+         dbvzAddSysclks(quietSysclks);
+         skipClk32s(quietClk32s);
+         sysclks -= quietSysclks;
+      }
+      else{
+         dbvzAddSysclks(sysclksToClk32);
+         nextClk32();
+         sysclks -= sysclksToClk32;
+      }
+   }
+}
+
+void dbvzSyncToCpu(void){
+   //the timers only catch up with the CPU at the end of its timeslice, anything that changes how they count has to bring them up to date first
+   if(cpuSliceRunning){
+      uint32_t sysclks = FAST_MIN(cpuCyclesToSysclks(flx68000CyclesRun(), cpuSliceSpeed), cpuSliceSysclks);
+
+      if(sysclks > cpuSliceSysclksDone){
+         addTime(sysclks - cpuSliceSysclksDone);
+         cpuSliceSysclksDone = sysclks;
+      }
+
+      //the end of the timeslice was worked out with the old values
+      flx68000EndTimeslice();
+   }
+}
+
 static int32_t audioGetFramePercentIncrementFromClk32s(int32_t count){
-   return (double)count / ((double)M515_CRYSTAL_FREQUENCY / EMU_FPS) * AUDIO_END_OF_FRAME;
+   return count * (AUDIO_CLOCK_RATE / M515_CRYSTAL_FREQUENCY);
 }
 
-static int32_t audioGetFramePercentIncrementFromSysclks(double count){
-   return count / (dbvzSysclksPerClk32 * ((double)M515_CRYSTAL_FREQUENCY / EMU_FPS)) * AUDIO_END_OF_FRAME;
+static int32_t audioGetFramePercentIncrementFromSysclks(uint32_t count){
+   return (uint64_t)count * (AUDIO_CLOCK_RATE / M515_CRYSTAL_FREQUENCY) / dbvzSysclksPerClk32;
 }
 
 static int32_t audioGetFramePercentage(void){
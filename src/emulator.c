@@ -6,6 +6,7 @@
 #include "audio/blip_buf.h"
 #include "emulator.h"
 #include "dbvz.h"
+#include "flx68000.h"
 #include "expansionHardware.h"
 #include "m515Bus.h"
 #include "sed1376.h"
@@ -43,6 +44,13 @@
 
 
 static bool emulatorInitialized = false;
+static uint32_t sdCardChangedRangeBlock;//where emulatorGetSdCardChangedRange() continues from
+static uint16_t* framebuffers[FRAMEBUFFER_COUNT];
+static uint8_t  framebufferBack;//only used by the emulator thread
+static uint8_t  framebufferFront;//only used by the thread calling emulatorGetFramebuffer()
+static uint32_t framebufferHandoff;//index of the newest finished frame, FRAMEBUFFER_HANDOFF_NEW is set until emulatorGetFramebuffer() takes it
+
+#define FRAMEBUFFER_HANDOFF_NEW 0x80000000
 
 #if defined(EMU_SUPPORT_PALM_OS5)
 bool      palmEmulatingTungstenT3;
@@ -54,18 +62,77 @@ sd_card_t palmSdCard;
 misc_hw_t palmMisc;
 emu_reg_t palmEmuFeatures;
 uint16_t* palmFramebuffer;
+bool      palmFramebufferChanged;
 uint16_t  palmFramebufferWidth;
 uint16_t  palmFramebufferHeight;
 int16_t*  palmAudio;
 blip_t*   palmAudioResampler;
-double    palmCycleCounter;//can be greater then 0 if too many cycles where run
-double    palmClockMultiplier;//used by the emulator to overclock the emulated Palm
+uint32_t  palmCycleCounter;//can be greater then 0 if too many cycles where run
+uint32_t  palmClockMultiplier;//used by the emulator to overclock the emulated Palm
 void      (*palmGetRtcFromHost)(uint8_t* writeBack);//[0] = hours, [1] = minutes, [2] = seconds
 
 
+static void framebuffersInit(uint32_t frameSize, bool shared){
+   uint8_t index;
+
+   //palmFramebuffer is the allocation holding all of them
+   for(index = 0; index < FRAMEBUFFER_COUNT; index++)
+      framebuffers[index] = shared ? palmFramebuffer : palmFramebuffer + frameSize * index;
+   framebufferBack = 0;
+   framebufferHandoff = 1;
+   framebufferFront = 2;
+   palmFramebuffer = framebuffers[framebufferHandoff];
+}
+
+static void framebuffersPublish(void){
+   //the finished frame becomes the newest one and the emulator gets back whichever buffer the frontend isnt reading
+   palmFramebuffer = framebuffers[framebufferBack];
+   framebufferBack = ATOMIC_EXCHANGE_32(&framebufferHandoff, framebufferBack | FRAMEBUFFER_HANDOFF_NEW) & ~FRAMEBUFFER_HANDOFF_NEW;
+#if defined(EMU_SUPPORT_PALM_OS5)
+   if(palmEmulatingTungstenT3)
+      pxa255Framebuffer = framebuffers[framebufferBack];
+   else
+#endif
+      sed1376Framebuffer = framebuffers[framebufferBack];
+}
+
+static uint32_t sdCardDirtyBlocksSize(uint32_t flashChipSize){
+   return ((flashChipSize + SD_CARD_BLOCK_SIZE - 1) / SD_CARD_BLOCK_SIZE + 7) / 8;
+}
+
+static uint32_t sdCardOverlayChunks(uint32_t flashChipSize){
+   return (flashChipSize + SD_CARD_OVERLAY_CHUNK_SIZE - 1) / SD_CARD_OVERLAY_CHUNK_SIZE;
+}
+
+static void sdCardFreeOverlayChunks(void){
+   uint32_t chunks = sdCardOverlayChunks(palmSdCard.flashChipSize);
+   uint32_t index;
+
+   for(index = 0; index < chunks; index++){
+      free(palmSdCard.flashChipOverlay[index]);
+      palmSdCard.flashChipOverlay[index] = NULL;
+   }
+}
+
+static void sdCardFreeFlashChip(void){
+   if(palmSdCard.flashChipOverlay){
+      sdCardFreeOverlayChunks();
+      free(palmSdCard.flashChipOverlay);
+   }
+   if(!palmSdCard.flashChipDataIsExternal)
+      free(palmSdCard.flashChipData);
+   free(palmSdCard.flashChipDirtyBlocks);
+   palmSdCard.flashChipData = NULL;
+   palmSdCard.flashChipOverlay = NULL;
+   palmSdCard.flashChipDirtyBlocks = NULL;
+   palmSdCard.flashChipSize = 0x00000000;
+   palmSdCard.flashChipDataIsExternal = false;
+   sdCardChangedRangeBlock = 0;
+}
+
 uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmBootloaderData, uint32_t palmBootloaderSize, uint32_t enabledEmuFeatures){
    //only accept valid non debug features from the user
-   enabledEmuFeatures &= FEATURE_FAST_CPU | FEATURE_SYNCED_RTC | FEATURE_HLE_APIS | FEATURE_DURABLE;
+   enabledEmuFeatures &= FEATURE_FAST_CPU | FEATURE_SYNCED_RTC | FEATURE_HLE_APIS | FEATURE_DURABLE | FEATURE_PIPELINED_VIDEO;
 
 #if defined(EMU_DEBUG)
    //enable debug features if compiled in debug mode
@@ -89,7 +156,7 @@ uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmB
       bool dynarecInited = false;
 
       dynarecInited = pxa255Init(&palmRom, &palmRam);
-      palmFramebuffer = malloc(320 * 480 * sizeof(uint16_t));
+      palmFramebuffer = malloc(320 * 480 * sizeof(uint16_t));//the PXA255 LCD streams pixels across frames, so every slot shares 1 buffer
       palmAudio = malloc(AUDIO_SAMPLES_PER_FRAME * 2 * sizeof(int16_t));
       palmAudioResampler = blip_new(AUDIO_SAMPLE_RATE);//have 1 second of samples
       if(!palmFramebuffer || !palmAudio || !palmAudioResampler || !dynarecInited){
@@ -111,12 +178,14 @@ uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmB
       memset(&palmEmuFeatures, 0x00, sizeof(palmEmuFeatures));
       palmFramebufferWidth = 320;
       palmFramebufferHeight = 480;
+      palmFramebufferChanged = true;
       palmMisc.batteryLevel = 100;
-      palmCycleCounter = 0.0;
+      palmCycleCounter = 0;
       palmEmuFeatures.info = enabledEmuFeatures;
 
       //initialize components, I dont think theres much in a Tungsten T3
-      pxa255Framebuffer = palmFramebuffer;
+      framebuffersInit(320 * 480, true);
+      pxa255Framebuffer = framebuffers[framebufferBack];
       blip_set_rates(palmAudioResampler, AUDIO_CLOCK_RATE, AUDIO_SAMPLE_RATE);
       sandboxInit();
 
@@ -130,7 +199,7 @@ uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmB
       //allocate buffers, add 4 to memory regions to prevent SIGSEGV from accessing off the end
       palmRom = malloc(M515_ROM_SIZE + 4);
       palmRam = malloc(M515_RAM_SIZE + 4);
-      palmFramebuffer = malloc(160 * 220 * sizeof(uint16_t));
+      palmFramebuffer = malloc(160 * 220 * sizeof(uint16_t) * FRAMEBUFFER_COUNT);
       palmAudio = malloc(AUDIO_SAMPLES_PER_FRAME * 2 * sizeof(int16_t));
       palmAudioResampler = blip_new(AUDIO_SAMPLE_RATE);//have 1 second of samples
       if(!palmRom || !palmRam || !palmFramebuffer || !palmAudio || !palmAudioResampler){
@@ -149,7 +218,15 @@ uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmB
       swap16BufferIfLittle(palmRom, M515_ROM_SIZE / sizeof(uint16_t));
       memset(palmRam, 0x00, M515_RAM_SIZE);
       dbvzLoadBootloader(palmBootloaderData, palmBootloaderSize);
-      memcpy(palmFramebuffer + 160 * 160, silkscreen160x60, 160 * 60 * sizeof(uint16_t));
+      framebuffersInit(160 * 220, false);
+      {
+         uint8_t index;
+
+         for(index = 0; index < FRAMEBUFFER_COUNT; index++){
+            memset(framebuffers[index], 0x00, 160 * 160 * sizeof(uint16_t));
+            memcpy(framebuffers[index] + 160 * 160, silkscreen160x60, 160 * 60 * sizeof(uint16_t));
+         }
+      }
       memset(palmAudio, 0x00, AUDIO_SAMPLES_PER_FRAME * 2/*channels*/ * sizeof(int16_t));
       memset(&palmInput, 0x00, sizeof(palmInput));
       memset(&palmMisc, 0x00, sizeof(palmMisc));
@@ -157,14 +234,22 @@ uint32_t emulatorInit(uint8_t* palmRomData, uint32_t palmRomSize, uint8_t* palmB
       memset(&palmEmuFeatures, 0x00, sizeof(palmEmuFeatures));
       palmFramebufferWidth = 160;
       palmFramebufferHeight = 220;
+      palmFramebufferChanged = true;
       palmMisc.batteryLevel = 100;
-      palmCycleCounter = 0.0;
+      palmCycleCounter = 0;
       palmEmuFeatures.info = enabledEmuFeatures;
-      sed1376Framebuffer = palmFramebuffer;
+      sed1376Framebuffer = framebuffers[framebufferBack];
 
       //initialize components
       blip_set_rates(palmAudioResampler, AUDIO_CLOCK_RATE, AUDIO_SAMPLE_RATE);
       sandboxInit();
+      {
+         uint16_t trap;
+
+         //every Palm OS API with a host version uses it, the frontend can turn them off one at a time after this
+         for(trap = 0xA000; trap < 0xB000; trap++)
+            expansionHardwareSetTrapHle(trap, !!(enabledEmuFeatures & FEATURE_HLE_APIS));
+      }
 
       //reset everything
       emulatorSoftReset();
@@ -188,14 +273,14 @@ void emulatorDeinit(void){
 #if defined(EMU_SUPPORT_PALM_OS5)
       }
 #endif
-      free(palmFramebuffer);
+      free(framebuffers[0]);
       free(palmAudio);
       blip_delete(palmAudioResampler);
 #if defined(EMU_SUPPORT_PALM_OS5)
       if(palmEmulatingTungstenT3)
          pxa255Deinit();
 #endif
-      free(palmSdCard.flashChipData);
+      sdCardFreeFlashChip();
       emulatorInitialized = false;
    }
 }
@@ -225,14 +310,14 @@ void emulatorSoftReset(void){
 #if defined(EMU_SUPPORT_PALM_OS5)
    if(palmEmulatingTungstenT3){
       palmEmuFeatures.value = 0x00000000;
-      palmClockMultiplier = 1.00;
+      palmClockMultiplier = 0x10000;
       pxa255Reset();
       sandboxReset();
    }
    else{
 #endif
       palmEmuFeatures.value = 0x00000000;
-      palmClockMultiplier = 1.00 - DBVZ_CPU_PERCENT_WAITING;
+      palmClockMultiplier = (1.00 - DBVZ_CPU_PERCENT_WAITING) * 0x10000;
       sed1376Reset();
       ads7846Reset();
       pdiUsbD12Reset();
@@ -431,7 +516,7 @@ bool emulatorSaveState(uint8_t* data, uint32_t size){
    offset += sizeof(uint32_t);
    writeStateValue8(data + offset, palmSdCard.sdInfo.writeProtectSwitch);
    offset += sizeof(uint8_t);
-   memcpy(data + offset, palmSdCard.flashChipData, palmSdCard.flashChipSize);
+   sdCardReadFlash(data + offset, 0, palmSdCard.flashChipSize);
    offset += palmSdCard.flashChipSize;
 
    return true;
@@ -442,6 +527,7 @@ bool emulatorLoadState(uint8_t* data, uint32_t size){
    uint8_t index;
    uint32_t stateSdCardSize;
    uint8_t* stateSdCardBuffer;
+   uint8_t* stateSdCardDirtyBlocks;
 
    //state validation, wont load states that are not from the same state version
 #if defined(EMU_SUPPORT_PALM_OS5)
@@ -459,10 +545,28 @@ bool emulatorLoadState(uint8_t* data, uint32_t size){
    offset += sizeof(uint32_t);
 
    //SD card size, the malloc when loading can make it fail, make sure if it fails the emulator state doesnt change
+   //a card of the same size is loaded in place so a mapped image stays mapped
    stateSdCardSize = readStateValue64(data + offset);
-   stateSdCardBuffer = stateSdCardSize > 0 ? malloc(stateSdCardSize) : NULL;
-   if(stateSdCardSize > 0 && !stateSdCardBuffer)
-      return false;
+   if(stateSdCardSize > 0 && stateSdCardSize == palmSdCard.flashChipSize){
+      //an overlay card needs its chunks now, the card data is the last thing in the state
+      if(!sdCardReserveFlash(0, data + emulatorGetStateSize() - stateSdCardSize, stateSdCardSize))
+         return false;
+      stateSdCardBuffer = palmSdCard.flashChipData;
+      stateSdCardDirtyBlocks = palmSdCard.flashChipDirtyBlocks;
+   }
+   else if(stateSdCardSize > 0){
+      stateSdCardBuffer = malloc(stateSdCardSize);
+      stateSdCardDirtyBlocks = malloc(sdCardDirtyBlocksSize(stateSdCardSize));
+      if(!stateSdCardBuffer || !stateSdCardDirtyBlocks){
+         free(stateSdCardBuffer);
+         free(stateSdCardDirtyBlocks);
+         return false;
+      }
+   }
+   else{
+      stateSdCardBuffer = NULL;
+      stateSdCardDirtyBlocks = NULL;
+   }
    offset += sizeof(uint64_t);
 
    //screen state
@@ -576,16 +680,24 @@ bool emulatorLoadState(uint8_t* data, uint32_t size){
    offset += sizeof(uint32_t);
    palmSdCard.sdInfo.writeProtectSwitch = readStateValue8(data + offset);
    offset += sizeof(uint8_t);
-   if(palmSdCard.flashChipData)
-      free(palmSdCard.flashChipData);
-   palmSdCard.flashChipData = stateSdCardBuffer;
-   palmSdCard.flashChipSize = stateSdCardSize;
-   memcpy(palmSdCard.flashChipData, data + offset, stateSdCardSize);
+   if(stateSdCardBuffer != palmSdCard.flashChipData){
+      sdCardFreeFlashChip();
+      palmSdCard.flashChipData = stateSdCardBuffer;
+      palmSdCard.flashChipDirtyBlocks = stateSdCardDirtyBlocks;
+      palmSdCard.flashChipSize = stateSdCardSize;
+   }
+   //marks the whole card as changed, an overlay card only keeps the chunks that differ from its base image, they where reserved above so this cant fail
+   sdCardWriteFlash(0, data + offset, stateSdCardSize);
    offset += stateSdCardSize;
 
    //some modules depend on all the state memory being loaded before certian required actions can occur(refreshing cached data, freeing memory blocks)
    dbvzLoadStateFinished();
 
+#if defined(EMU_SUPPORT_PALM_OS5)
+   if(!palmEmulatingTungstenT3)
+#endif
+      sed1376Snapshot();//a state is the end of a frame, FEATURE_PIPELINED_VIDEO draws it next instead of whatever was on screen before
+
    return true;
 }
 
@@ -634,6 +746,7 @@ bool emulatorLoadRam(uint8_t* data, uint32_t size){
 
       memcpy(palmRam, data, M515_RAM_SIZE);
       swap16BufferIfLittle(palmRam, M515_RAM_SIZE / sizeof(uint16_t));
+      flx68000FlushPredecodeCache();
 #if defined(EMU_SUPPORT_PALM_OS5)
    }
 #endif
@@ -641,7 +754,7 @@ bool emulatorLoadRam(uint8_t* data, uint32_t size){
    return true;
 }
 
-uint32_t emulatorInsertSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo){
+static uint32_t sdCardInsert(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo, bool useDataInPlace){
    //from the no name SD card that came instered in my test device
    static const sd_card_info_t defaultSdInfo = {
       {0x00, 0x2F, 0x00, 0x32, 0x5F, 0x59, 0x83, 0xB8, 0x6D, 0xB7, 0xFF, 0x9F, 0x96, 0x40, 0x00, 0x00},//csd
@@ -659,22 +772,30 @@ uint32_t emulatorInsertSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdIn
    if(size == 0x00000000 || size > 0x20000000)
       return EMU_ERROR_INVALID_PARAMETER;
 
-   //add SD_CARD_BLOCK_SIZE to buffer to prevent buffer overflows
-   palmSdCard.flashChipSize = size;
-   palmSdCard.flashChipData = malloc(palmSdCard.flashChipSize + SD_CARD_BLOCK_SIZE);
-   if(!palmSdCard.flashChipData){
-      palmSdCard.flashChipSize = 0x00000000;
+   palmSdCard.flashChipDirtyBlocks = malloc(sdCardDirtyBlocksSize(size));
+   if(!palmSdCard.flashChipDirtyBlocks)
       return EMU_ERROR_OUT_OF_MEMORY;
-   }
+   memset(palmSdCard.flashChipDirtyBlocks, 0x00, sdCardDirtyBlocksSize(size));
 
-   //copy over buffer data
-   if(data)
-      memcpy(palmSdCard.flashChipData, data, size);
-   else
-      memset(palmSdCard.flashChipData, 0x00, size);
+   if(useDataInPlace){
+      palmSdCard.flashChipData = data;
+      palmSdCard.flashChipDataIsExternal = true;
+   }
+   else{
+      palmSdCard.flashChipData = malloc(size);
+      if(!palmSdCard.flashChipData){
+         free(palmSdCard.flashChipDirtyBlocks);
+         palmSdCard.flashChipDirtyBlocks = NULL;
+         return EMU_ERROR_OUT_OF_MEMORY;
+      }
 
-   //clear the padding block
-   memset(palmSdCard.flashChipData + palmSdCard.flashChipSize, 0x00, SD_CARD_BLOCK_SIZE);
+      //copy over buffer data
+      if(data)
+         memcpy(palmSdCard.flashChipData, data, size);
+      else
+         memset(palmSdCard.flashChipData, 0x00, size);
+   }
+   palmSdCard.flashChipSize = size;
 
    //reinit SD card
    if(sdInfo)
@@ -686,6 +807,114 @@ uint32_t emulatorInsertSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdIn
    return EMU_ERROR_NONE;
 }
 
+uint32_t emulatorInsertSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo){
+   return sdCardInsert(data, size, sdInfo, false);
+}
+
+uint32_t emulatorMapSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo){
+   if(!data)
+      return EMU_ERROR_INVALID_PARAMETER;
+
+   return sdCardInsert(data, size, sdInfo, true);
+}
+
+uint32_t emulatorInsertSdCardOverlay(uint8_t* baseData, uint32_t size, sd_card_info_t* sdInfo){
+   uint32_t error;
+
+   error = emulatorMapSdCard(baseData, size, sdInfo);
+   if(error != EMU_ERROR_NONE)
+      return error;
+
+   palmSdCard.flashChipOverlay = malloc(sdCardOverlayChunks(size) * sizeof(uint8_t*));
+   if(!palmSdCard.flashChipOverlay){
+      sdCardFreeFlashChip();
+      return EMU_ERROR_OUT_OF_MEMORY;
+   }
+   memset(palmSdCard.flashChipOverlay, 0x00, sdCardOverlayChunks(size) * sizeof(uint8_t*));
+
+   return EMU_ERROR_NONE;
+}
+
+uint32_t emulatorGetSdCardOverlaySize(void){
+   uint32_t chunks = sdCardOverlayChunks(palmSdCard.flashChipSize);
+   uint32_t size = 0;
+   uint32_t index;
+
+   if(!palmSdCard.flashChipOverlay)
+      return 0;
+
+   for(index = 0; index < chunks; index++)
+      if(palmSdCard.flashChipOverlay[index])
+         size += sizeof(uint32_t) + SD_CARD_OVERLAY_CHUNK_SIZE;//chunk offset, chunk data
+
+   return size;
+}
+
+uint32_t emulatorSaveSdCardOverlay(uint8_t* data, uint32_t size){
+   uint32_t chunks = sdCardOverlayChunks(palmSdCard.flashChipSize);
+   uint32_t offset = 0;
+   uint32_t index;
+
+   if(!palmSdCard.flashChipOverlay)
+      return EMU_ERROR_RESOURCE_LOCKED;
+
+   if(size < emulatorGetSdCardOverlaySize())
+      return EMU_ERROR_OUT_OF_MEMORY;
+
+   for(index = 0; index < chunks; index++){
+      if(palmSdCard.flashChipOverlay[index]){
+         writeStateValue32(data + offset, index * SD_CARD_OVERLAY_CHUNK_SIZE);
+         offset += sizeof(uint32_t);
+         memcpy(data + offset, palmSdCard.flashChipOverlay[index], SD_CARD_OVERLAY_CHUNK_SIZE);
+         offset += SD_CARD_OVERLAY_CHUNK_SIZE;
+      }
+   }
+
+   return EMU_ERROR_NONE;
+}
+
+uint32_t emulatorLoadSdCardOverlay(uint8_t* data, uint32_t size){
+   uint32_t offset;
+
+   if(!palmSdCard.flashChipData)
+      return EMU_ERROR_RESOURCE_LOCKED;
+
+   //check the whole thing before writing anything
+   if(size % (sizeof(uint32_t) + SD_CARD_OVERLAY_CHUNK_SIZE) != 0)
+      return EMU_ERROR_INVALID_PARAMETER;
+   for(offset = 0; offset < size; offset += sizeof(uint32_t) + SD_CARD_OVERLAY_CHUNK_SIZE){
+      uint32_t chunkAddress = readStateValue32(data + offset);
+
+      if(chunkAddress % SD_CARD_OVERLAY_CHUNK_SIZE != 0 || chunkAddress >= palmSdCard.flashChipSize)
+         return EMU_ERROR_INVALID_PARAMETER;
+   }
+
+   for(offset = 0; offset < size; offset += sizeof(uint32_t) + SD_CARD_OVERLAY_CHUNK_SIZE)
+      if(!sdCardWriteFlash(readStateValue32(data + offset), data + offset + sizeof(uint32_t), SD_CARD_OVERLAY_CHUNK_SIZE))
+         return EMU_ERROR_OUT_OF_MEMORY;
+
+   return EMU_ERROR_NONE;
+}
+
+uint32_t emulatorCommitSdCardOverlay(void){
+   uint32_t chunks = sdCardOverlayChunks(palmSdCard.flashChipSize);
+   uint32_t index;
+
+   if(!palmSdCard.flashChipOverlay)
+      return EMU_ERROR_RESOURCE_LOCKED;
+
+   for(index = 0; index < chunks; index++){
+      if(palmSdCard.flashChipOverlay[index]){
+         uint32_t chunkAddress = index * SD_CARD_OVERLAY_CHUNK_SIZE;
+
+         memcpy(palmSdCard.flashChipData + chunkAddress, palmSdCard.flashChipOverlay[index], FAST_MIN(palmSdCard.flashChipSize - chunkAddress, SD_CARD_OVERLAY_CHUNK_SIZE));
+      }
+   }
+   sdCardFreeOverlayChunks();
+
+   return EMU_ERROR_NONE;
+}
+
 uint32_t emulatorGetSdCardSize(void){
    if(!palmSdCard.flashChipData)
       return 0;
@@ -700,32 +929,106 @@ uint32_t emulatorGetSdCardData(uint8_t* data, uint32_t size){
    if(size < palmSdCard.flashChipSize)
       return EMU_ERROR_OUT_OF_MEMORY;
 
-   memcpy(data, palmSdCard.flashChipData, palmSdCard.flashChipSize);
+   sdCardReadFlash(data, 0, palmSdCard.flashChipSize);
+
+   return EMU_ERROR_NONE;
+}
+
+uint32_t emulatorReadSdCard(uint8_t* data, uint32_t offset, uint32_t size){
+   if(!palmSdCard.flashChipData)
+      return EMU_ERROR_RESOURCE_LOCKED;
+
+   if(offset > palmSdCard.flashChipSize || size > palmSdCard.flashChipSize - offset)
+      return EMU_ERROR_INVALID_PARAMETER;
+
+   sdCardReadFlash(data, offset, size);
 
    return EMU_ERROR_NONE;
 }
 
+bool emulatorGetSdCardChangedRange(uint32_t* offset, uint32_t* size){
+   uint32_t blocks = (palmSdCard.flashChipSize + SD_CARD_BLOCK_SIZE - 1) / SD_CARD_BLOCK_SIZE;
+   uint32_t firstBlock = sdCardChangedRangeBlock;
+   uint32_t endBlock;
+
+   //skip clean blocks, 8 at a time when possible
+   while(firstBlock < blocks){
+      if(firstBlock % 8 == 0 && !palmSdCard.flashChipDirtyBlocks[firstBlock / 8])
+         firstBlock += 8;
+      else if(!(palmSdCard.flashChipDirtyBlocks[firstBlock / 8] & 1 << firstBlock % 8))
+         firstBlock++;
+      else
+         break;
+   }
+
+   if(firstBlock >= blocks){
+      //back to the start for the next write back
+      sdCardChangedRangeBlock = 0;
+      return false;
+   }
+
+   //take every dirty block in a row
+   endBlock = firstBlock;
+   while(endBlock < blocks && palmSdCard.flashChipDirtyBlocks[endBlock / 8] & 1 << endBlock % 8){
+      palmSdCard.flashChipDirtyBlocks[endBlock / 8] &= ~(1 << endBlock % 8);
+      endBlock++;
+   }
+   sdCardChangedRangeBlock = endBlock;
+
+   *offset = firstBlock * SD_CARD_BLOCK_SIZE;
+   *size = FAST_MIN(endBlock * SD_CARD_BLOCK_SIZE, palmSdCard.flashChipSize) - *offset;
+   return true;
+}
+
 void emulatorEjectSdCard(void){
    //clear SD flash chip, this disables the SD card control chip too
-   if(palmSdCard.flashChipData){
-      free(palmSdCard.flashChipData);
-      palmSdCard.flashChipData = NULL;
-      palmSdCard.flashChipSize = 0x00000000;
+   if(palmSdCard.flashChipData)
+      sdCardFreeFlashChip();
+}
+
+void emulatorQueueInput(input_t* input, float frameTime){
+#if defined(EMU_SUPPORT_PALM_OS5)
+   if(palmEmulatingTungstenT3){
+      //the PXA255 side only looks at the input once a frame
+      palmInput = *input;
+      return;
    }
+#endif
+
+   dbvzQueueInput(input, frameTime > 0.0 ? frameTime * (M515_CRYSTAL_FREQUENCY / EMU_FPS) : 0);
 }
 
 void emulatorRunFrame(void){
 #if defined(EMU_SUPPORT_PALM_OS5)
    if(palmEmulatingTungstenT3){
       pxa255Execute(true);
+      palmFramebufferChanged = true;
+      framebuffersPublish();
    }
    else{
 #endif
-      //CPU
-      dbvzExecute();
+      if(palmEmuFeatures.info & FEATURE_PIPELINED_VIDEO){
+         //the LCD controller draws the last frame while the CPU runs this one
+         MULTITHREAD_SECTIONS{
+            MULTITHREAD_SECTION{
+               dbvzExecute();
+            }
+            MULTITHREAD_SECTION{
+               palmFramebufferChanged = sed1376Render();
+            }
+         }
+         sed1376Snapshot();
+      }
+      else{
+         //CPU
+         dbvzExecute();
 
-      //LCD controller
-      sed1376Render();
+         //LCD controller
+         sed1376Snapshot();
+         palmFramebufferChanged = sed1376Render();
+      }
+      if(palmFramebufferChanged)
+         framebuffersPublish();
 #if defined(EMU_SUPPORT_PALM_OS5)
    }
 #endif
@@ -740,6 +1043,7 @@ void emulatorSkipFrame(void){
 #if defined(EMU_SUPPORT_PALM_OS5)
    if(palmEmulatingTungstenT3){
       pxa255Execute(false);
+      palmFramebufferChanged = false;
    }
    else{
 #endif
@@ -748,6 +1052,11 @@ void emulatorSkipFrame(void){
 
       //LCD controller, skip this
       //sed1376Render();
+      palmFramebufferChanged = false;
+
+      //FEATURE_PIPELINED_VIDEO draws the next frame from this snapshot
+      if(palmEmuFeatures.info & FEATURE_PIPELINED_VIDEO)
+         sed1376Snapshot();
 #if defined(EMU_SUPPORT_PALM_OS5)
    }
 #endif
@@ -756,3 +1065,14 @@ void emulatorSkipFrame(void){
    sandboxOnFrameRun();
 #endif
 }
+
+uint16_t* emulatorGetFramebuffer(bool* newFrame){
+   bool fresh = !!(ATOMIC_LOAD_32(&framebufferHandoff) & FRAMEBUFFER_HANDOFF_NEW);
+
+   //swap the buffer this thread was reading for the newest one, the emulator never writes to either until they are handed back
+   if(fresh)
+      framebufferFront = ATOMIC_EXCHANGE_32(&framebufferHandoff, framebufferFront) & ~FRAMEBUFFER_HANDOFF_NEW;
+   if(newFrame)
+      *newFrame = fresh;
+   return framebuffers[framebufferFront];
+}
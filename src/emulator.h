@@ -20,6 +20,8 @@ extern "C" {
 //define EMU_MULTITHREADED to speed up long loops
 //define EMU_MANAGE_HOST_CPU_PIPELINE to optimize the CPU pipeline for the most common cases
 //define EMU_NO_SAFETY to remove all safety checks
+//define EMU_M68K_DYNAREC to recompile 68k code on x86_64 hosts, only works with EMU_NO_SAFETY
+//define EMU_NO_SIMD to use the plain C paths instead of SSE2 or NEON
 //define EMU_BIG_ENDIAN on big endian systems
 //define EMU_HAVE_FILE_LAUNCHER to enable launching files from the host system
 //to enable degguging define EMU_DEBUG, all options below do nothing unless EMU_DEBUG is defined
@@ -46,7 +48,6 @@ static void debugLog(char* str, ...){};
 
 //config options
 #define EMU_FPS 60
-#define DBVZ_SYSCLK_PRECISION 2000000//the amount of cycles to run before adding SYSCLKs, higher = faster, higher values may skip timer events and lower audio accuracy
 #define DBVZ_CPU_PERCENT_WAITING 0.30//account for wait states when reading memory, tested with SysInfo.prc
 #define AUDIO_SAMPLE_RATE 48000
 #define AUDIO_CLOCK_RATE 235929600//smallest amount of time a second can be split into:(2.0 * (14.0 * (255 + 1.0) + 15 + 1.0)) * 32768 == 235929600, used to convert the variable timing of SYSCLK and CLK32 to a fixed location in the current frame 0<->AUDIO_END_OF_FRAME
@@ -54,8 +55,11 @@ static void debugLog(char* str, ...){};
 #define SD_CARD_BLOCK_SIZE 512//all newer SDSC cards have this fixed at 512
 #define SD_CARD_BLOCK_DATA_PACKET_SIZE (1 + SD_CARD_BLOCK_SIZE + 2)
 #define SD_CARD_RESPONSE_FIFO_SIZE (SD_CARD_BLOCK_DATA_PACKET_SIZE * 3)
+#define SD_CARD_OVERLAY_CHUNK_SIZE (SD_CARD_BLOCK_SIZE * 8)//an overlay copys this much of the base image on the first write to it, same as 1 byte of flashChipDirtyBlocks
 #define SD_CARD_NCR_BYTES 1//how many 0xFF bytes come before the R1 response
-#define SAVE_STATE_VERSION 0x00000001
+#define SAVE_STATE_VERSION 0x00000005
+#define FRAMEBUFFER_COUNT 3//the emulator renders into one while the frontend reads another and the third holds the newest finished frame
+#define INPUT_QUEUE_SIZE 64//inputs that can be waiting for the next frame, when full the newest one is replaced instead
 #if defined(EMU_SUPPORT_PALM_OS5)
 #define SAVE_STATE_FOR_TUNGSTEN_T3 0x80000000
 #endif
@@ -138,7 +142,10 @@ typedef struct{
    bool           inIdleState;
    sd_card_info_t sdInfo;
    uint8_t*       flashChipData;
+   uint8_t**      flashChipOverlay;//NULL unless the card is an overlay, 1 pointer per SD_CARD_OVERLAY_CHUNK_SIZE, chunks that are NULL havent been written and are read from flashChipData
+   uint8_t*       flashChipDirtyBlocks;//1 bit per SD_CARD_BLOCK_SIZE block, set when the block is written and cleared when emulatorGetSdCardChangedRange() returns it
    uint32_t       flashChipSize;
+   bool           flashChipDataIsExternal;//from emulatorMapSdCard(), the frontend frees it
 }sd_card_t;
 
 typedef struct{
@@ -170,13 +177,14 @@ extern input_t   palmInput;//write allowed
 extern sd_card_t palmSdCard;//access allowed to read flash chip data without allocating a giant buffer
 extern misc_hw_t palmMisc;//read/write allowed
 extern emu_reg_t palmEmuFeatures;//dont touch
-extern uint16_t* palmFramebuffer;//read allowed
+extern uint16_t* palmFramebuffer;//read allowed, the newest finished frame, only safe to use between frames on the emulator thread, use emulatorGetFramebuffer() from other threads
+extern bool      palmFramebufferChanged;//read allowed, false if the last frame left palmFramebuffer untouched so the frontend can skip presenting it
 extern uint16_t  palmFramebufferWidth;//read allowed
 extern uint16_t  palmFramebufferHeight;//read allowed
 extern int16_t*  palmAudio;//read allowed, 2 channel signed 16 bit audio
 extern blip_t*   palmAudioResampler;//dont touch
-extern double    palmCycleCounter;//dont touch
-extern double    palmClockMultiplier;//read/write allowed, setting by multiplication and cacheing the result is the best way
+extern uint32_t  palmCycleCounter;//dont touch
+extern uint32_t  palmClockMultiplier;//read/write allowed, 16.16 fixed point, setting by multiplication and cacheing the result is the best way
 extern void      (*palmGetRtcFromHost)(uint8_t* writeBack);//[0] = hours, [1] = minutes, [2] = seconds
 
 //functions
@@ -193,10 +201,21 @@ bool emulatorSaveRam(uint8_t* data, uint32_t size);//true = success
 bool emulatorLoadRam(uint8_t* data, uint32_t size);//true = success
 uint32_t emulatorInsertSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo);//use (NULL, desired size) to create a new empty SD card, pass NULL for sdInfo to use defaults
 uint32_t emulatorGetSdCardSize(void);
+uint32_t emulatorMapSdCard(uint8_t* data, uint32_t size, sd_card_info_t* sdInfo);//same as emulatorInsertSdCard() but uses data in place instead of copying it(a mapped image file), it must stay valid until the card is ejected
+uint32_t emulatorInsertSdCardOverlay(uint8_t* baseData, uint32_t size, sd_card_info_t* sdInfo);//same as emulatorMapSdCard() but baseData is never written so many emulators can share it, writes are kept in a per emulator overlay that only uses memory for the chunks that changed
+uint32_t emulatorGetSdCardOverlaySize(void);
+uint32_t emulatorSaveSdCardOverlay(uint8_t* data, uint32_t size);//saves only the chunks the overlay has changed, flashChipData is the base image on an overlay card so use this or emulatorReadSdCard() instead
+uint32_t emulatorLoadSdCardOverlay(uint8_t* data, uint32_t size);//applys a saved overlay on top of the current card
+uint32_t emulatorCommitSdCardOverlay(void);//writes the overlay into the base image and frees it, only safe when no other emulator is using the base image
 uint32_t emulatorGetSdCardData(uint8_t* data, uint32_t size);
+uint32_t emulatorReadSdCard(uint8_t* data, uint32_t offset, uint32_t size);//reads part of the card the way the emulated Palm sees it, use with emulatorGetSdCardChangedRange() since flashChipData is only the base image on an overlay card
+bool emulatorGetSdCardChangedRange(uint32_t* offset, uint32_t* size);//true = offset and size are set to a range of the SD card written since it was last returned, call until false to write back only what changed
 void emulatorEjectSdCard(void);
+void emulatorQueueInput(input_t* input, float frameTime);//input takes effect at frameTime into the next frame, 0.0 = start, 1.0 = end, queue in order and dont write palmInput directly while using this
 void emulatorRunFrame(void);
 void emulatorSkipFrame(void);
+uint16_t* emulatorGetFramebuffer(bool* newFrame);//safe to call from any 1 thread while frames are running, returns the newest finished frame and leaves it untouched until the next call, newFrame can be NULL
+
    
 #ifdef __cplusplus
 }
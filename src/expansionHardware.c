@@ -11,26 +11,276 @@
 #include "sed1376.h"
 #include "flx68000.h"
 #include "debug/sandbox.h"
+#include "debug/trapNames.h"
+#include "m68k/m68k.h"
 
 
-void expansionHardwareReset(void){
+#define HLE_API_COUNT (CMD_STRLEN + 1)
+#define PALM_OS_TRAP_TABLE 0x000008CC//where Palm OS 4 keeps the trap dispatch table, same as printTrapInfo() in sandbox.c
+
+
+static uint32_t hleCycleCost[HLE_API_COUNT];//what the CPU is charged for each HLE API call, the work itself is done on the host
+static bool     trapHleEnabled[0x1000];//indexed by the trap number without the 0xA000
+
+
+static uint32_t bytesLeftInBank(uint32_t address, bool backwards){
+   return backwards ? (address & DBVZ_BANK_MASK) + 1 : DBVZ_BANK_MASK + 1 - (address & DBVZ_BANK_MASK);
+}
+
+static void hostMove(uint8_t* dstBank, uint32_t dst, uint8_t* srcBank, uint32_t src, uint32_t size){
+   //both ranges are within one bank and stored in the M68K_BUFFER_* layout
+#if !defined(EMU_BIG_ENDIAN)
+   if((dst ^ src) & 1){
+      //the bytes in each 16 bit word are swapped, a copy between odd and even addresses has to be done a byte at a time
+      uint32_t index;
+
+      if(dstBank == srcBank && (dst & DBVZ_BANK_MASK) > (src & DBVZ_BANK_MASK))
+         for(index = size; index > 0; index--)
+            M68K_BUFFER_WRITE_8(dstBank, dst + index - 1, DBVZ_BANK_MASK, M68K_BUFFER_READ_8(srcBank, src + index - 1, DBVZ_BANK_MASK));
+      else
+         for(index = 0; index < size; index++)
+            M68K_BUFFER_WRITE_8(dstBank, dst + index, DBVZ_BANK_MASK, M68K_BUFFER_READ_8(srcBank, src + index, DBVZ_BANK_MASK));
+   }
+   else{
+      //whole words can be moved as is, the odd bytes on the ends are read first in case the ranges overlap
+      uint8_t first = M68K_BUFFER_READ_8(srcBank, src, DBVZ_BANK_MASK);
+      uint8_t last = M68K_BUFFER_READ_8(srcBank, src + size - 1, DBVZ_BANK_MASK);
+      uint32_t wordStart = src & 1;
+
+      memmove(dstBank + (dst & DBVZ_BANK_MASK) + wordStart, srcBank + (src & DBVZ_BANK_MASK) + wordStart, (size - wordStart) & ~1);
+      M68K_BUFFER_WRITE_8(dstBank, dst, DBVZ_BANK_MASK, first);
+      M68K_BUFFER_WRITE_8(dstBank, dst + size - 1, DBVZ_BANK_MASK, last);
+   }
+#else
+   memmove(dstBank + (dst & DBVZ_BANK_MASK), srcBank + (src & DBVZ_BANK_MASK), size);
+#endif
+}
+
+static void hleMemmove(uint32_t dst, uint32_t src, uint32_t size){
+   //same as memmove, overlapping ranges are copied from the end when the destination is after the source
+   bool backwards = dst - src < size && dst != src;
+
+   while(size > 0){
+      uint32_t srcChunk = backwards ? src + size - 1 : src;
+      uint32_t dstChunk = backwards ? dst + size - 1 : dst;
+      uint32_t length = size;
+      uint8_t* srcBank = m515GetHostReadBank(srcChunk);
+      uint8_t* dstBank = m515GetHostWriteBank(dstChunk);
+
+      length = FAST_MIN(length, bytesLeftInBank(srcChunk, backwards));
+      length = FAST_MIN(length, bytesLeftInBank(dstChunk, backwards));
+      srcChunk = backwards ? srcChunk - length + 1 : srcChunk;
+      dstChunk = backwards ? dstChunk - length + 1 : dstChunk;
+
+      if(srcBank != NULL && dstBank != NULL){
+         hostMove(dstBank, dstChunk, srcBank, srcChunk, length);
+         m515HostWroteRam(dstChunk, length);
+      }
+      else{
+         //anything that isnt plain RAM or ROM, or is protected, goes through the bus like the CPU would
+         uint32_t index;
+
+         if(backwards)
+            for(index = length; index > 0; index--)
+               m68k_write_memory_8(dstChunk + index - 1, m68k_read_memory_8(srcChunk + index - 1));
+         else
+            for(index = 0; index < length; index++)
+               m68k_write_memory_8(dstChunk + index, m68k_read_memory_8(srcChunk + index));
+      }
+
+      if(!backwards){
+         src += length;
+         dst += length;
+      }
+      size -= length;
+   }
+}
+
+static void hleMemset(uint32_t dst, uint8_t value, uint32_t size){
+   while(size > 0){
+      uint32_t length = FAST_MIN(size, bytesLeftInBank(dst, false));
+      uint8_t* dstBank = m515GetHostWriteBank(dst);
+
+      if(dstBank != NULL){
+         //the byte order doesnt matter when every byte is the same, only a partial word on either end needs to be done alone
+         uint32_t wordStart = ((dst & DBVZ_BANK_MASK) + 1) & ~1;
+         uint32_t wordEnd = ((dst & DBVZ_BANK_MASK) + length) & ~1;
+
+         if(wordEnd > wordStart)
+            memset(dstBank + wordStart, value, wordEnd - wordStart);
+         M68K_BUFFER_WRITE_8(dstBank, dst, DBVZ_BANK_MASK, value);
+         M68K_BUFFER_WRITE_8(dstBank, dst + length - 1, DBVZ_BANK_MASK, value);
+         m515HostWroteRam(dst, length);
+      }
+      else{
+         uint32_t index;
+
+         for(index = 0; index < length; index++)
+            m68k_write_memory_8(dst + index, value);
+      }
+
+      dst += length;
+      size -= length;
+   }
+}
+
+static bool inStringMemory(uint32_t address){
+   //strings are only followed through RAM and ROM, a missing terminator ends the string at the edge of them instead of walking the whole address space
+   uint8_t bankType = dbvzBankType[DBVZ_START_BANK(address)];
+
+   return bankType == DBVZ_CHIP_DX_RAM || bankType == DBVZ_CHIP_A0_ROM;
+}
+
+static int32_t hleMemcmp(uint32_t s1, uint32_t s2, uint32_t size, bool stopAtTerminator){
+   uint32_t index;
+
+   for(index = 0; index < size; index++){
+      uint8_t c1;
+      uint8_t c2;
+
+      if(stopAtTerminator && (!inStringMemory(s1 + index) || !inStringMemory(s2 + index)))
+         break;
+
+      c1 = m68k_read_memory_8(s1 + index);
+      c2 = m68k_read_memory_8(s2 + index);
+      if(c1 != c2)
+         return (int32_t)c1 - (int32_t)c2;
+      if(stopAtTerminator && c1 == '\0')
+         break;
+   }
+
+   return 0;
+}
+
+static void hleStrncpy(uint32_t dst, uint32_t src, uint32_t size, bool padWithTerminators){
+   uint32_t index;
+
+   for(index = 0; index < size; index++){
+      uint8_t value;
+
+      if(!inStringMemory(src + index) || !inStringMemory(dst + index))
+         break;
+
+      value = m68k_read_memory_8(src + index);
+      m68k_write_memory_8(dst + index, value);
+      if(value == '\0'){
+         if(padWithTerminators)
+            hleMemset(dst + index + 1, '\0', size - index - 1);
+         break;
+      }
+   }
+}
+
+static uint32_t hleStrlen(uint32_t src){
+   uint32_t length = 0;
+
+   while(inStringMemory(src + length) && m68k_read_memory_8(src + length) != '\0')
+      length++;
+
+   return length;
+}
+
+static bool trapHleImplemented(uint16_t trap){
+   switch(trap){
+      case MemMove:
+      case MemSet:
+      case StrCopy:
+      case StrLen:
+         return true;
+
+      default:
+         return false;
+   }
+}
 
+void expansionHardwareSetTrapHle(uint16_t trap, bool enabled){
+   if((trap & 0xF000) == 0xA000 && trapHleImplemented(trap))
+      trapHleEnabled[trap & 0x0FFF] = enabled;
+}
+
+bool expansionHardwareRunTrap(uint16_t trap){
+   uint32_t stack;
+
+   if((trap & 0xF000) != 0xA000 || !trapHleEnabled[trap & 0x0FFF])
+      return false;
+
+   //Palm OS apps always run in supervisor mode, and a trap that has been patched has to go to the patch
+   if(!flx68000IsSupervisor() || dbvzBankType[DBVZ_START_BANK(m68k_read_memory_32(PALM_OS_TRAP_TABLE + (trap & 0x0FFF) * 4))] != DBVZ_CHIP_A0_ROM)
+      return false;
+
+   //the arguments are on the stack in order, pointers and Int32s are 4 bytes, everything else is 2, a UInt8 is in the first byte of its 2
+   stack = m68k_get_reg(NULL, M68K_REG_A7);
+   switch(trap){
+      case MemMove:{
+            //Err MemMove(void* dstP, const void* sP, Int32 numBytes)
+            int32_t numBytes = m68k_read_memory_32(stack + 8);
+
+            if(numBytes > 0)
+               hleMemmove(m68k_read_memory_32(stack), m68k_read_memory_32(stack + 4), numBytes);
+            m68k_set_reg(M68K_REG_D0, 0);
+            flx68000UseCycles(hleCycleCost[CMD_MEMCPY]);
+         }
+         return true;
+
+      case MemSet:{
+            //Err MemSet(void* dstP, Int32 numBytes, UInt8 value)
+            int32_t numBytes = m68k_read_memory_32(stack + 4);
+
+            if(numBytes > 0)
+               hleMemset(m68k_read_memory_32(stack), m68k_read_memory_8(stack + 8), numBytes);
+            m68k_set_reg(M68K_REG_D0, 0);
+            flx68000UseCycles(hleCycleCost[CMD_MEMSET]);
+         }
+         return true;
+
+      case StrCopy:
+         //Char* StrCopy(Char* dst, const Char* src)
+         hleStrncpy(m68k_read_memory_32(stack), m68k_read_memory_32(stack + 4), UINT32_MAX, false);
+         m68k_set_reg(M68K_REG_A0, m68k_read_memory_32(stack));
+         flx68000UseCycles(hleCycleCost[CMD_STRCPY]);
+         return true;
+
+      case StrLen:
+         //UInt16 StrLen(const Char* src)
+         m68k_set_reg(M68K_REG_D0, hleStrlen(m68k_read_memory_32(stack)) & 0xFFFF);
+         flx68000UseCycles(hleCycleCost[CMD_STRLEN]);
+         return true;
+
+      default:
+         return false;
+   }
+}
+
+void expansionHardwareReset(void){
+   memset(hleCycleCost, 0x00, sizeof(hleCycleCost));
 }
 
 uint32_t expansionHardwareStateSize(void){
    uint32_t size = 0;
 
+   size += sizeof(uint32_t) * HLE_API_COUNT;//hleCycleCost
+
    return size;
 }
 
 void expansionHardwareSaveState(uint8_t* data){
    uint32_t offset = 0;
+   uint8_t index;
 
+   for(index = 0; index < HLE_API_COUNT; index++){
+      writeStateValue32(data + offset, hleCycleCost[index]);
+      offset += sizeof(uint32_t);
+   }
 }
 
 void expansionHardwareLoadState(uint8_t* data){
    uint32_t offset = 0;
+   uint8_t index;
 
+   for(index = 0; index < HLE_API_COUNT; index++){
+      hleCycleCost[index] = readStateValue32(data + offset);
+      offset += sizeof(uint32_t);
+   }
 }
 
 uint32_t expansionHardwareGetRegister(uint32_t address){
@@ -69,9 +319,72 @@ void expansionHardwareSetRegister(uint32_t address, uint32_t value){
 
       case EMU_CMD:
          switch(value){
+            case CMD_MEMCPY:
+            case CMD_MEMSET:
+            case CMD_MEMCMP:
+            case CMD_STRCPY:
+            case CMD_STRNCPY:
+            case CMD_STRCMP:
+            case CMD_STRNCMP:
+            case CMD_STRLEN:
+               if(palmEmuFeatures.info & FEATURE_HLE_APIS){
+                  switch(value){
+                     case CMD_MEMCPY:
+                        hleMemmove(palmEmuFeatures.dst, palmEmuFeatures.src, palmEmuFeatures.size);
+                        break;
+
+                     case CMD_MEMSET:
+                        hleMemset(palmEmuFeatures.dst, palmEmuFeatures.value, palmEmuFeatures.size);
+                        break;
+
+                     case CMD_MEMCMP:
+                        palmEmuFeatures.value = hleMemcmp(palmEmuFeatures.src, palmEmuFeatures.dst, palmEmuFeatures.size, false);
+                        break;
+
+                     case CMD_STRCPY:
+                        hleStrncpy(palmEmuFeatures.dst, palmEmuFeatures.src, UINT32_MAX, false);
+                        break;
+
+                     case CMD_STRNCPY:
+                        hleStrncpy(palmEmuFeatures.dst, palmEmuFeatures.src, palmEmuFeatures.size, true);
+                        break;
+
+                     case CMD_STRCMP:
+                        palmEmuFeatures.value = hleMemcmp(palmEmuFeatures.src, palmEmuFeatures.dst, UINT32_MAX, true);
+                        break;
+
+                     case CMD_STRNCMP:
+                        palmEmuFeatures.value = hleMemcmp(palmEmuFeatures.src, palmEmuFeatures.dst, palmEmuFeatures.size, true);
+                        break;
+
+                     case CMD_STRLEN:
+                        palmEmuFeatures.value = hleStrlen(palmEmuFeatures.src);
+                        break;
+                  }
+
+                  flx68000UseCycles(hleCycleCost[value]);
+               }
+               return;
+
             case CMD_SET_CPU_SPEED:
-               if(palmEmuFeatures.info & FEATURE_FAST_CPU)
-                  palmClockMultiplier = (double)palmEmuFeatures.value / 100.0 * (1.00 - DBVZ_CPU_PERCENT_WAITING);
+               if(palmEmuFeatures.info & FEATURE_FAST_CPU){
+                  dbvzSyncToCpu();
+                  palmClockMultiplier = (uint64_t)palmEmuFeatures.value * (uint32_t)((1.00 - DBVZ_CPU_PERCENT_WAITING) * 0x10000) / 100;
+               }
+               return;
+
+            case CMD_IDLE_X_CLK32:
+               if(palmEmuFeatures.info & FEATURE_HLE_APIS)
+                  dbvzIdleCpu(palmEmuFeatures.value);
+               return;
+
+            case CMD_SET_CYCLE_COST:
+               if(palmEmuFeatures.info & FEATURE_HLE_APIS){
+                  if(palmEmuFeatures.dst < HLE_API_COUNT)
+                     hleCycleCost[palmEmuFeatures.dst] = palmEmuFeatures.value;
+                  else
+                     debugLog("Invalid HLE API 0x%08X for CMD_SET_CYCLE_COST.\n", palmEmuFeatures.dst);
+               }
                return;
 
             case CMD_DEBUG_PRINT:
@@ -2,6 +2,7 @@
 #define EXPANSION_HARDWARE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 void expansionHardwareReset(void);
 uint32_t expansionHardwareStateSize(void);
@@ -14,4 +15,7 @@ void expansionHardwareRenderDisplay(void);
 uint32_t expansionHardwareGetRegister(uint32_t address);
 void expansionHardwareSetRegister(uint32_t address, uint32_t value);
 
+void expansionHardwareSetTrapHle(uint16_t trap, bool enabled);//only traps with a host version can be enabled, all of them are when FEATURE_HLE_APIS is set
+bool expansionHardwareRunTrap(uint16_t trap);//returns true if the trap was done on the host and the guest version shouldnt run
+
 #endif
@@ -5,6 +5,7 @@
 #include "portability.h"
 #include "dbvz.h"
 #include "m515Bus.h"
+#include "expansionHardware.h"
 #include "m68k/m68kcpu.h"
 
 
@@ -79,6 +80,54 @@ uint32_t  m68k_read_pcrelative_32(uint32_t address){
 #endif
 #endif
 
+//an idle loop that only reads memory can only be broken by an interrupt, one that reads hardware registers has to look again once time has passed
+static uint32_t idleLoopWrites;
+static uint32_t idleLoopIoReads;
+static int32_t  idleLoopArmCycles;
+static bool     idleLoopSpinning;
+static bool     idleLoopWaitingForInterrupt;
+
+void flx68000IdleLoopArm(void){
+   idleLoopWrites = m515BusWrites;
+   idleLoopIoReads = m515BusIoReads;
+   idleLoopArmCycles = m68k_cycles_run();
+}
+
+bool flx68000IdleLoop(uint32_t pc){
+   if(m515BusWrites != idleLoopWrites)
+      return false;
+
+   idleLoopSpinning = true;
+   idleLoopWaitingForInterrupt = m515BusIoReads == idleLoopIoReads;
+   return true;
+}
+
+bool flx68000Trap(uint8_t vector){
+   //Palm OS API calls are TRAP #15 followed by the API number
+   if(vector == 15 && expansionHardwareRunTrap(m68k_read_memory_16(REG_PC))){
+      m68ki_jump(REG_PC + 2);
+      return true;
+   }
+
+   return false;
+}
+
+//opcodes fetched from ROM never change, RAM is watched for writes by m515Bus.c, everything else is too rare to be worth caching
+uint32_t* flx68000GetCodeGeneration(uint32_t address){
+   static uint32_t romCodeGeneration = 1;
+
+   switch(dbvzBankType[DBVZ_START_BANK(address)]){
+      case DBVZ_CHIP_A0_ROM:
+         return &romCodeGeneration;
+
+      case DBVZ_CHIP_DX_RAM:
+         return &m515RamCodeGeneration[(address & dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask) >> M515_CODE_PAGE_SCOOT];
+
+      default:
+         return NULL;
+   }
+}
+
 void flx68000Reset(void){
    static bool inited = false;
 
@@ -239,14 +288,52 @@ void flx68000LoadState(uint8_t* data){
 }
 
 void flx68000LoadStateFinished(void){
+   //the memory map and RAM have changed
+   m68k_flush_predecode_cache();
+
 #if M68K_SEPARATE_READS
    //set PC accessor to the PC from the state
    flx68000PcLongJump(m68ki_cpu.pc);
 #endif
 }
 
-void flx68000Execute(int32_t cycles){
-   m68k_execute(cycles);
+void flx68000FlushPredecodeCache(void){
+   m68k_flush_predecode_cache();
+#if M68K_SEPARATE_READS
+   //the memory map changed, opcodes may now come from somewhere else
+   flx68000PcLongJump(m68ki_cpu.pc);
+#endif
+}
+
+int32_t flx68000Execute(int32_t cycles){
+   int32_t cyclesRun;
+
+   idleLoopSpinning = false;
+   idleLoopWaitingForInterrupt = false;
+   cyclesRun = m68k_execute(cycles);
+
+   //nothing new happened after the start of the last time around the loop
+   return idleLoopSpinning ? idleLoopArmCycles : cyclesRun;
+}
+
+int32_t flx68000CyclesRun(void){
+   return m68k_cycles_run();
+}
+
+bool flx68000IsSpinning(void){
+   return idleLoopSpinning;
+}
+
+bool flx68000IsWaitingForInterrupt(void){
+   return idleLoopWaitingForInterrupt || CPU_STOPPED;
+}
+
+void flx68000EndTimeslice(void){
+   m68k_end_timeslice();
+}
+
+void flx68000UseCycles(int32_t cycles){
+   USE_CYCLES(cycles);
 }
 
 void flx68000SetIrq(uint8_t irqLevel){
@@ -254,7 +341,7 @@ void flx68000SetIrq(uint8_t irqLevel){
 }
 
 bool flx68000IsSupervisor(void){
-   return !!(m68k_get_reg(NULL, M68K_REG_SR) & 0x2000);
+   return !!FLAG_S;
 }
 
 void flx68000BusError(uint32_t address, bool isWrite){
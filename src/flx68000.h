@@ -10,7 +10,13 @@ void flx68000SaveState(uint8_t* data);
 void flx68000LoadState(uint8_t* data);
 void flx68000LoadStateFinished(void);
 
-void flx68000Execute(int32_t cycles);
+void flx68000FlushPredecodeCache(void);
+int32_t flx68000Execute(int32_t cycles);//returns how many cycles were run, or how many it took to start spinning
+int32_t flx68000CyclesRun(void);//only valid during flx68000Execute()
+bool flx68000IsSpinning(void);//true if the last flx68000Execute() ended in a loop that does the same thing until something outside the CPU changes
+bool flx68000IsWaitingForInterrupt(void);//true if the CPU cant do anything new until an interrupt
+void flx68000EndTimeslice(void);
+void flx68000UseCycles(int32_t cycles);//for work done by the host on the CPUs behalf, only valid during flx68000Execute()
 void flx68000SetIrq(uint8_t irqLevel);
 bool flx68000IsSupervisor(void);
 void flx68000BusError(uint32_t address, bool isWrite);
@@ -12,7 +12,33 @@
 #include "debug/sandbox.h"
 
 
-uint8_t dbvzBankType[DBVZ_TOTAL_MEMORY_BANKS];
+uint8_t  dbvzBankType[DBVZ_TOTAL_MEMORY_BANKS];
+uint32_t m515RamCodeGeneration[M515_RAM_SIZE >> M515_CODE_PAGE_SCOOT];//odd values mean the page has predecoded opcodes
+uint32_t m515BusWrites;//counts every write, used to tell if a loop has side effects
+uint32_t m515BusIoReads;//counts reads of anything but RAM and ROM, used to tell if a loop can see time pass
+
+//plain RAM and ROM banks are accessed through these without going through probeRead/probeWrite and the chip switch, NULL means take the slow path
+static uint8_t* dbvzBankReadPointer[DBVZ_TOTAL_MEMORY_BANKS];
+static uint8_t* dbvzBankWritePointer[DBVZ_TOTAL_MEMORY_BANKS];
+
+#if !defined(EMU_NO_SAFETY)
+//a set bit means an access to that bank with that privilege level(0 = user, 1 = supervisor) may be denied and needs probeRead/probeWrite
+static uint32_t dbvzBankReadProbe[2][DBVZ_TOTAL_MEMORY_BANKS / 32];
+static uint32_t dbvzBankWriteProbe[2][DBVZ_TOTAL_MEMORY_BANKS / 32];
+
+#define BANK_BIT_TEST(bitmap, bank) ((bitmap)[(bank) >> 5] & (uint32_t)1 << ((bank) & 31))
+#define BANK_BIT_SET(bitmap, bank, set) ((bitmap)[(bank) >> 5] = ((bitmap)[(bank) >> 5] & ~((uint32_t)1 << ((bank) & 31))) | ((uint32_t)!!(set) << ((bank) & 31)))
+#endif
+
+
+//writing to a page with predecoded opcodes makes its generation even, which invalidates them
+//the last byte of a write is checked too, unaligned writes can cross into the next page when EMU_NO_SAFETY is set
+static void ramInvalidateCode(uint32_t address){
+   uint32_t* generation = &m515RamCodeGeneration[(address & dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask) >> M515_CODE_PAGE_SCOOT];
+
+   if(unlikely(*generation & 1))
+      (*generation)++;
+}
 
 
 //ROM accesses
@@ -24,9 +50,9 @@ static uint32_t romRead32(uint32_t address){return M68K_BUFFER_READ_32(palmRom,
 static uint8_t ramRead8(uint32_t address){return M68K_BUFFER_READ_8(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask);}
 static uint16_t ramRead16(uint32_t address){return M68K_BUFFER_READ_16(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask);}
 static uint32_t ramRead32(uint32_t address){return M68K_BUFFER_READ_32(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask);}
-static void ramWrite8(uint32_t address, uint8_t value){M68K_BUFFER_WRITE_8(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value);}
-static void ramWrite16(uint32_t address, uint16_t value){M68K_BUFFER_WRITE_16(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value);}
-static void ramWrite32(uint32_t address, uint32_t value){M68K_BUFFER_WRITE_32(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value);}
+static void ramWrite8(uint32_t address, uint8_t value){M68K_BUFFER_WRITE_8(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value); ramInvalidateCode(address);}
+static void ramWrite16(uint32_t address, uint16_t value){M68K_BUFFER_WRITE_16(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value); ramInvalidateCode(address); ramInvalidateCode(address + 1);}
+static void ramWrite32(uint32_t address, uint32_t value){M68K_BUFFER_WRITE_32(palmRam, address, dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask, value); ramInvalidateCode(address); ramInvalidateCode(address + 3);}
 
 //SED1376 accesses
 static uint8_t sed1376Read8(uint32_t address){
@@ -60,20 +86,28 @@ static uint32_t sed1376Read32(uint32_t address){
       return sed1376GetRegister(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
 }
 static void sed1376Write8(uint32_t address, uint8_t value){
-   if(address & SED1376_MR_BIT)
+   if(address & SED1376_MR_BIT){
       M68K_BUFFER_WRITE_8_BIG_ENDIAN(sed1376Ram, address, dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
+      sed1376MarkRamDirty(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
+   }
    else
       sed1376SetRegister(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
 }
 static void sed1376Write16(uint32_t address, uint16_t value){
-   if(address & SED1376_MR_BIT)
+   if(address & SED1376_MR_BIT){
       M68K_BUFFER_WRITE_16_BIG_ENDIAN(sed1376Ram, address, dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
+      sed1376MarkRamDirty(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
+      sed1376MarkRamDirty((address + 1) & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
+   }
    else
       sed1376SetRegister(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
 }
 static void sed1376Write32(uint32_t address, uint32_t value){
-   if(address & SED1376_MR_BIT)
+   if(address & SED1376_MR_BIT){
       M68K_BUFFER_WRITE_32_BIG_ENDIAN(sed1376Ram, address, dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
+      sed1376MarkRamDirty(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
+      sed1376MarkRamDirty((address + 3) & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask);
+   }
    else
       sed1376SetRegister(address & dbvzChipSelects[DBVZ_CHIP_B0_SED].mask, value);
 }
@@ -111,10 +145,16 @@ static bool probeWrite(uint8_t bank, uint32_t address){
 }
 
 uint8_t m68k_read_memory_8(uint32_t address){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankReadPointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   if(likely(hostBank != NULL))
+      return M68K_BUFFER_READ_8(hostBank, address, DBVZ_BANK_MASK);
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeRead(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankReadProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeRead(addressType, address))
       return 0x00;
 #endif
 
@@ -122,6 +162,9 @@ uint8_t m68k_read_memory_8(uint32_t address){
    sandboxOnMemoryAccess(address, 8, false, 0);
 #endif
 
+   if(addressType != DBVZ_CHIP_DX_RAM && addressType != DBVZ_CHIP_A0_ROM)
+      m515BusIoReads++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return romRead8(address);
@@ -153,10 +196,16 @@ uint8_t m68k_read_memory_8(uint32_t address){
 }
 
 uint16_t m68k_read_memory_16(uint32_t address){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankReadPointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   if(likely(hostBank != NULL))
+      return M68K_BUFFER_READ_16(hostBank, address, DBVZ_BANK_MASK);
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeRead(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankReadProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeRead(addressType, address))
       return 0x0000;
 #endif
 
@@ -164,6 +213,9 @@ uint16_t m68k_read_memory_16(uint32_t address){
    sandboxOnMemoryAccess(address, 16, false, 0);
 #endif
 
+   if(addressType != DBVZ_CHIP_DX_RAM && addressType != DBVZ_CHIP_A0_ROM)
+      m515BusIoReads++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return romRead16(address);
@@ -195,10 +247,17 @@ uint16_t m68k_read_memory_16(uint32_t address){
 }
 
 uint32_t m68k_read_memory_32(uint32_t address){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankReadPointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   //a 32 bit access at the end of a bank spills into the next one, the chip handler wraps it properly
+   if(likely(hostBank != NULL && (address & DBVZ_BANK_MASK) <= DBVZ_BANK_MASK - 3))
+      return M68K_BUFFER_READ_32(hostBank, address, DBVZ_BANK_MASK);
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeRead(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankReadProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeRead(addressType, address))
       return 0x00000000;
 #endif
 
@@ -206,6 +265,9 @@ uint32_t m68k_read_memory_32(uint32_t address){
    sandboxOnMemoryAccess(address, 32, false, 0);
 #endif
 
+   if(addressType != DBVZ_CHIP_DX_RAM && addressType != DBVZ_CHIP_A0_ROM)
+      m515BusIoReads++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return romRead32(address);
@@ -237,10 +299,20 @@ uint32_t m68k_read_memory_32(uint32_t address){
 }
 
 void m68k_write_memory_8(uint32_t address, uint8_t value){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankWritePointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   if(likely(hostBank != NULL)){
+      M68K_BUFFER_WRITE_8(hostBank, address, DBVZ_BANK_MASK, value);
+      ramInvalidateCode(address);
+      m515BusWrites++;
+      return;
+   }
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeWrite(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankWriteProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeWrite(addressType, address))
       return;
 #endif
 
@@ -248,6 +320,8 @@ void m68k_write_memory_8(uint32_t address, uint8_t value){
    sandboxOnMemoryAccess(address, 8, true, value);
 #endif
 
+   m515BusWrites++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return;
@@ -283,10 +357,21 @@ void m68k_write_memory_8(uint32_t address, uint8_t value){
 }
 
 void m68k_write_memory_16(uint32_t address, uint16_t value){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankWritePointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   if(likely(hostBank != NULL)){
+      M68K_BUFFER_WRITE_16(hostBank, address, DBVZ_BANK_MASK, value);
+      ramInvalidateCode(address);
+      ramInvalidateCode(address + 1);
+      m515BusWrites++;
+      return;
+   }
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeWrite(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankWriteProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeWrite(addressType, address))
       return;
 #endif
 
@@ -294,6 +379,8 @@ void m68k_write_memory_16(uint32_t address, uint16_t value){
    sandboxOnMemoryAccess(address, 16, true, value);
 #endif
 
+   m515BusWrites++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return;
@@ -329,10 +416,21 @@ void m68k_write_memory_16(uint32_t address, uint16_t value){
 }
 
 void m68k_write_memory_32(uint32_t address, uint32_t value){
-   uint8_t addressType = dbvzBankType[DBVZ_START_BANK(address)];
+   uint8_t* hostBank = dbvzBankWritePointer[DBVZ_START_BANK(address)];
+   uint8_t addressType;
+
+   if(likely(hostBank != NULL && (address & DBVZ_BANK_MASK) <= DBVZ_BANK_MASK - 3)){
+      M68K_BUFFER_WRITE_32(hostBank, address, DBVZ_BANK_MASK, value);
+      ramInvalidateCode(address);
+      ramInvalidateCode(address + 3);
+      m515BusWrites++;
+      return;
+   }
+
+   addressType = dbvzBankType[DBVZ_START_BANK(address)];
 
 #if !defined(EMU_NO_SAFETY)
-   if(!probeWrite(addressType, address))
+   if(unlikely(BANK_BIT_TEST(dbvzBankWriteProbe[flx68000IsSupervisor()], DBVZ_START_BANK(address))) && !probeWrite(addressType, address))
       return;
 #endif
 
@@ -340,6 +438,8 @@ void m68k_write_memory_32(uint32_t address, uint32_t value){
    sandboxOnMemoryAccess(address, 32, true, value);
 #endif
 
+   m515BusWrites++;
+
    switch(addressType){
       case DBVZ_CHIP_A0_ROM:
          return;
@@ -384,6 +484,25 @@ uint8_t m68k_read_disassembler_8(uint32_t address){return m68k_read_memory_8(add
 uint16_t m68k_read_disassembler_16(uint32_t address){return m68k_read_memory_16(address);}
 uint32_t m68k_read_disassembler_32(uint32_t address){return m68k_read_memory_32(address);}
 
+uint8_t* m515GetHostReadBank(uint32_t address){
+   return dbvzBankReadPointer[DBVZ_START_BANK(address)];
+}
+
+uint8_t* m515GetHostWriteBank(uint32_t address){
+   return dbvzBankWritePointer[DBVZ_START_BANK(address)];
+}
+
+void m515HostWroteRam(uint32_t address, uint32_t size){
+   uint32_t offset;
+
+   //stepping a code page at a time hits every page in the range
+   for(offset = 0; offset < size; offset += 1 << M515_CODE_PAGE_SCOOT)
+      ramInvalidateCode(address + offset);
+   if(size > 0)
+      ramInvalidateCode(address + size - 1);
+   m515BusWrites++;
+}
+
 
 static uint8_t getProperBankType(uint32_t bank){
    //registers have first priority, they cover 0xFFFFF000(and 0xXXFFF000 when DMAP enabled in SCR) even if a chip select overlaps this area or DBVZ_CHIP_A0_ROM is in boot mode
@@ -406,11 +525,86 @@ static uint8_t getProperBankType(uint32_t bank){
    return DBVZ_CHIP_NONE;
 }
 
+#if !defined(EMU_NO_SAFETY)
+static bool bankIsUnprotected(uint8_t chip, uint32_t bank){
+   //every address in the bank is below the protected area of the chip select, same math as probeRead/probeWrite
+   uint32_t firstIndex = DBVZ_BANK_ADDRESS(bank) - dbvzChipSelects[chip].start;
+
+   return firstIndex + DBVZ_BANK_MASK >= firstIndex && firstIndex + DBVZ_BANK_MASK < dbvzChipSelects[chip].unprotectedSize;
+}
+#endif
+
+static uint8_t* getBankReadPointer(uint32_t bank){
+   uint8_t chip = dbvzBankType[bank];
+
+#if defined(EMU_DEBUG) && defined(EMU_SANDBOX) && defined(EMU_SANDBOX_LOG_MEMORY_ACCESSES)
+   //every access needs to be logged
+   return NULL;
+#endif
+
+   if(chip != DBVZ_CHIP_A0_ROM && chip != DBVZ_CHIP_DX_RAM)
+      return NULL;
+
+   //the chip has to cover at least a whole bank for the bank to map to one block of host memory
+   if((dbvzChipSelects[chip].mask & DBVZ_BANK_MASK) != DBVZ_BANK_MASK)
+      return NULL;
+
+#if !defined(EMU_NO_SAFETY)
+   if(dbvzChipSelects[chip].supervisorOnlyProtectedMemory && !bankIsUnprotected(chip, bank))
+      return NULL;
+#endif
+
+   return (chip == DBVZ_CHIP_A0_ROM ? palmRom : palmRam) + (DBVZ_BANK_ADDRESS(bank) & dbvzChipSelects[chip].mask);
+}
+
+static uint8_t* getBankWritePointer(uint32_t bank){
+#if defined(EMU_DEBUG) && defined(EMU_SANDBOX) && defined(EMU_SANDBOX_LOG_MEMORY_ACCESSES)
+   //every access needs to be logged
+   return NULL;
+#endif
+
+   //ROM writes are dropped, only RAM can be written directly
+   if(dbvzBankType[bank] != DBVZ_CHIP_DX_RAM || (dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask & DBVZ_BANK_MASK) != DBVZ_BANK_MASK)
+      return NULL;
+
+#if !defined(EMU_NO_SAFETY)
+   if(dbvzChipSelects[DBVZ_CHIP_DX_RAM].readOnly)
+      return NULL;
+   if((dbvzChipSelects[DBVZ_CHIP_DX_RAM].supervisorOnlyProtectedMemory || dbvzChipSelects[DBVZ_CHIP_DX_RAM].readOnlyForProtectedMemory) && !bankIsUnprotected(DBVZ_CHIP_DX_RAM, bank))
+      return NULL;
+#endif
+
+   return palmRam + (DBVZ_BANK_ADDRESS(bank) & dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask);
+}
+
+static void refreshBankAccess(uint32_t bank){
+   dbvzBankReadPointer[bank] = getBankReadPointer(bank);
+   dbvzBankWritePointer[bank] = getBankWritePointer(bank);
+
+#if !defined(EMU_NO_SAFETY)
+   {
+      dbvz_chip_t* chip = &dbvzChipSelects[dbvzBankType[bank]];
+      bool protectedArea = !bankIsUnprotected(dbvzBankType[bank], bank);
+
+      //same rules as probeRead/probeWrite, supervisor reads are never denied
+      BANK_BIT_SET(dbvzBankReadProbe[0], bank, chip->supervisorOnlyProtectedMemory && protectedArea);
+      BANK_BIT_SET(dbvzBankReadProbe[1], bank, false);
+      BANK_BIT_SET(dbvzBankWriteProbe[0], bank, chip->readOnly || ((chip->supervisorOnlyProtectedMemory || chip->readOnlyForProtectedMemory) && protectedArea));
+      BANK_BIT_SET(dbvzBankWriteProbe[1], bank, chip->readOnly || (chip->readOnlyForProtectedMemory && protectedArea));
+   }
+#endif
+}
+
 void dbvzSetRegisterXXFFAccessMode(void){
    uint32_t topByte;
 
-   MULTITHREAD_LOOP(topByte) for(topByte = 0; topByte < 0x100; topByte++)
-      dbvzBankType[DBVZ_START_BANK(topByte << 24 | 0x00FFF000)] = DBVZ_CHIP_REGISTERS;
+   MULTITHREAD_LOOP(topByte) for(topByte = 0; topByte < 0x100; topByte++){
+      uint32_t bank = DBVZ_START_BANK(topByte << 24 | 0x00FFF000);
+      dbvzBankType[bank] = DBVZ_CHIP_REGISTERS;
+      refreshBankAccess(bank);
+   }
+
+   flx68000FlushPredecodeCache();
 }
 
 void dbvzSetRegisterFFFFAccessMode(void){
@@ -419,12 +613,32 @@ void dbvzSetRegisterFFFFAccessMode(void){
    MULTITHREAD_LOOP(topByte) for(topByte = 0; topByte < 0x100; topByte++){
       uint32_t bank = DBVZ_START_BANK(topByte << 24 | 0x00FFF000);
       dbvzBankType[bank] = getProperBankType(bank);
+      refreshBankAccess(bank);
    }
+
+   flx68000FlushPredecodeCache();
 }
 
 void m515SetSed1376Attached(bool attached){
-   if(dbvzChipSelects[DBVZ_CHIP_B0_SED].enable && dbvzBankType[DBVZ_START_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start)] != (attached ? DBVZ_CHIP_B0_SED : DBVZ_CHIP_NONE))
+   if(dbvzChipSelects[DBVZ_CHIP_B0_SED].enable && dbvzBankType[DBVZ_START_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start)] != (attached ? DBVZ_CHIP_B0_SED : DBVZ_CHIP_NONE)){
+      uint32_t bank;
+
       memset(&dbvzBankType[DBVZ_START_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start)], attached ? DBVZ_CHIP_B0_SED : DBVZ_CHIP_NONE, DBVZ_END_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start, dbvzChipSelects[DBVZ_CHIP_B0_SED].lineSize) - DBVZ_START_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start) + 1);
+      for(bank = DBVZ_START_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start); bank <= DBVZ_END_BANK(dbvzChipSelects[DBVZ_CHIP_B0_SED].start, dbvzChipSelects[DBVZ_CHIP_B0_SED].lineSize); bank++)
+         refreshBankAccess(bank);
+   }
+}
+
+void dbvzRefreshBankAccess(void){
+   uint32_t word;
+
+   //each thread gets whole words of the protection bitmaps
+   MULTITHREAD_LOOP(word) for(word = 0; word < DBVZ_TOTAL_MEMORY_BANKS / 32; word++){
+      uint32_t bank;
+
+      for(bank = word * 32; bank < word * 32 + 32; bank++)
+         refreshBankAccess(bank);
+   }
 }
 
 void dbvzResetAddressSpace(void){
@@ -432,4 +646,7 @@ void dbvzResetAddressSpace(void){
 
    MULTITHREAD_LOOP(bank) for(bank = 0; bank < DBVZ_TOTAL_MEMORY_BANKS; bank++)
       dbvzBankType[bank] = getProperBankType(bank);
+
+   dbvzRefreshBankAccess();
+   flx68000FlushPredecodeCache();
 }
@@ -11,7 +11,9 @@
 #define DBVZ_END_BANK(address, size) (DBVZ_START_BANK(address) + DBVZ_NUM_BANKS(size) - 1)
 #define DBVZ_BANK_IN_RANGE(bank, address, size) ((bank) >= DBVZ_START_BANK(address) && (bank) <= DBVZ_END_BANK(address, size))
 #define DBVZ_BANK_ADDRESS(bank) ((bank) << DBVZ_BANK_SCOOT)
+#define DBVZ_BANK_MASK ((1 << DBVZ_BANK_SCOOT) - 1)
 #define DBVZ_TOTAL_MEMORY_BANKS (1 << (32 - DBVZ_BANK_SCOOT))//0x40000 banks for *_BANK_SCOOT = 14
+#define M515_CODE_PAGE_SCOOT 10//RAM is watched for writes to predecoded opcodes in 1kb pages
 
 //chip addresses and sizes
 //after boot RAM is at 0x00000000,
@@ -58,11 +60,19 @@
 #define M68K_BUFFER_WRITE_32_BIG_ENDIAN(segment, accessAddress, mask, value) (segment[(accessAddress) & (mask)] = (value) >> 24, segment[(accessAddress) + 1 & (mask)] = ((value) >> 16) & 0xFF, segment[(accessAddress) + 2 & (mask)] = ((value) >> 8) & 0xFF, segment[(accessAddress) + 3 & (mask)] = (value) & 0xFF)
 #endif
 
-extern uint8_t dbvzBankType[];
+extern uint8_t  dbvzBankType[];
+extern uint32_t m515RamCodeGeneration[];
+extern uint32_t m515BusWrites;
+extern uint32_t m515BusIoReads;
+
+uint8_t* m515GetHostReadBank(uint32_t address);//NULL means the bank has to be accessed through m68k_read_memory_*
+uint8_t* m515GetHostWriteBank(uint32_t address);//NULL means the bank has to be accessed through m68k_write_memory_*
+void m515HostWroteRam(uint32_t address, uint32_t size);//call after writing to a bank from m515GetHostWriteBank() directly, the range cant cross a bank
 
 void dbvzSetRegisterXXFFAccessMode(void);
 void dbvzSetRegisterFFFFAccessMode(void);
 void m515SetSed1376Attached(bool attached);
+void dbvzRefreshBankAccess(void);
 void dbvzResetAddressSpace(void);
 
 #endif
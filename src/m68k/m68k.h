@@ -290,6 +290,9 @@ void m68k_pulse_reset(void);
 /* execute num_cycles worth of instructions.  returns number of cycles used */
 int32_t m68k_execute(int32_t num_cycles);
 
+/* Forget every predecoded instruction, must be called when the memory map changes */
+void m68k_flush_predecode_cache(void);
+
 /* These functions let you read/write/modify the number of cycles left to run
  * while m68k_execute() is running.
  * These are useful if the 68k accesses a memory-mapped port on another device
@@ -147,6 +147,62 @@
 #define M68K_EMULATE_PREFETCH       OPT_OFF
 
 
+/* If ON, the CPU will remember the opcode, handler and base cycle count of
+ * each instruction it runs, keyed by PC, and skip the opcode fetch when the
+ * same PC is run again.
+ * M68K_GET_CODE_GENERATION(A) must return a pointer to a counter that changes
+ * whenever the memory holding A is written, or NULL if A must not be cached.
+ * m68k_flush_predecode_cache() must be called whenever the memory map changes.
+ */
+#if defined(EMU_DEBUG) && defined(EMU_SANDBOX) && defined(EMU_SANDBOX_OPCODE_LEVEL_DEBUG)
+#define M68K_PREDECODE_CACHE        OPT_OFF
+#else
+#define M68K_PREDECODE_CACHE        OPT_SPECIFY_HANDLER
+#endif
+#define M68K_GET_CODE_GENERATION(A) flx68000GetCodeGeneration(A)
+#define M68K_CODE_GENERATION_SIZE   0x400 /* bytes of memory covered by one counter */
+
+
+/* If ON, the CPU will recompile runs of common instructions into host code
+ * and run that instead of interpreting them, everything else is still
+ * interpreted.
+ * Uses the same M68K_GET_CODE_GENERATION(A) counters as the predecode cache.
+ * Only available on x86_64 hosts using the System V ABI, and only when the
+ * memory handlers cant longjmp out of an instruction.
+ */
+#if defined(EMU_M68K_DYNAREC) && defined(EMU_NO_SAFETY) && !defined(EMU_SANDBOX) && defined(__x86_64__) && !defined(_WIN32)
+#define M68K_TRANSLATE              OPT_ON
+#else
+#define M68K_TRANSLATE              OPT_OFF
+#endif
+
+
+/* If ON, short backward branches are watched for loops that keep coming back
+ * to the same place with every register unchanged.
+ * M68K_IDLE_LOOP_ARM() is called at the start of the iteration that gets
+ * compared, and M68K_IDLE_LOOP_CALLBACK(A) with the loop address at the end
+ * of it if nothing changed, if it returns true the loop is idle and the CPU
+ * ends its timeslice.
+ * The host has to check the iteration didnt write to memory, a loop that only
+ * reads will do the same thing forever until something outside the CPU
+ * changes.
+ * Recompiled blocks check their short backward branches the same way.
+ */
+#define M68K_IDLE_LOOP_DETECT       OPT_SPECIFY_HANDLER
+#define M68K_IDLE_LOOP_ARM()        flx68000IdleLoopArm()
+#define M68K_IDLE_LOOP_CALLBACK(A)  flx68000IdleLoop(A)
+#define M68K_IDLE_LOOP_SIZE         0x20 /* largest loop watched, in bytes */
+
+
+/* If ON, M68K_TRAP_CALLBACK(A) is called with the vector number(0-15) before
+ * a TRAP #n instruction takes its exception, if it returns true the host has
+ * already done what the trap would do(including moving the PC past anything
+ * after the opcode) and the exception is skipped.
+ */
+#define M68K_TRAP_HOOK              OPT_SPECIFY_HANDLER
+#define M68K_TRAP_CALLBACK(A)       flx68000Trap(A)
+
+
 /* If ON, the CPU will generate address error exceptions if it tries to
  * access a word or longword at an odd address.
  * NOTE: This is only emulated properly for 68000 mode.
@@ -38,6 +38,8 @@
 /* ================================ INCLUDES ============================== */
 /* ======================================================================== */
 
+#include <string.h>
+
 #include "m68kops.h"
 #include "m68kcpu.h"
 
@@ -72,6 +74,45 @@ m68ki_cpu_core m68ki_cpu = {0};
 jmp_buf m68ki_aerr_trap;
 #endif /* M68K_EMULATE_ADDRESS_ERROR */
 
+#if M68K_PREDECODE_CACHE
+/* Predecoded instructions, indexed by PC */
+#define M68K_PREDECODE_CACHE_SIZE 0x2000 /* must be a power of 2 */
+
+typedef struct
+{
+   uint    pc;                  /* PC of the opcode word */
+   uint32* generation;          /* host counter for the memory holding the opcode */
+   uint32  generation_snapshot; /* value of *generation when this entry was filled */
+   void    (*handler)(void);    /* opcode handler */
+   uint16  ir;                  /* opcode */
+   uint16  cycles;              /* base cycle count */
+} m68ki_predecoded_t;
+
+static m68ki_predecoded_t m68ki_predecode_cache[M68K_PREDECODE_CACHE_SIZE];
+static uint32 m68ki_predecode_dead_generation = 0; /* never matches a snapshot of 1 */
+#endif /* M68K_PREDECODE_CACHE */
+
+#if M68K_IDLE_LOOP_DETECT
+/* Idle loop detection */
+#define M68K_IDLE_LOOP_ARM_COUNT 4 /* iterations of a loop before one of them is compared */
+
+typedef struct
+{
+   uint dar[16];
+   uint x_flag;
+   uint n_flag;
+   uint not_z_flag;
+   uint v_flag;
+   uint c_flag;
+   uint s_flag;
+   uint int_mask;
+} m68ki_idle_state_t;
+
+static uint m68ki_idle_pc = 1;    /* loop being watched, odd means none */
+static uint m68ki_idle_count;     /* times the loop has been entered */
+static m68ki_idle_state_t m68ki_idle_snapshot; /* registers at the start of the compared iteration */
+#endif /* M68K_IDLE_LOOP_DETECT */
+
 uint    m68ki_aerr_type;
 uint    m68ki_aerr_address;
 uint    m68ki_aerr_write_mode;
@@ -650,6 +691,16 @@ int32_t m68k_execute(int32_t num_cycles)
       USE_CYCLES(CPU_INT_CYCLES);
       CPU_INT_CYCLES = 0;
 
+#if M68K_IDLE_LOOP_DETECT
+      /* the compared iteration has to be in this timeslice, the host may have
+       * changed something since the last one and the armed cycle count is
+       * only meaningful inside the timeslice that took it, a loop that was
+       * already being watched is armed again the next time around
+       */
+      if(m68ki_idle_count >= M68K_IDLE_LOOP_ARM_COUNT)
+         m68ki_idle_count = M68K_IDLE_LOOP_ARM_COUNT - 1;
+#endif /* M68K_IDLE_LOOP_DETECT */
+
       /* Return point if we had an address error */
       m68ki_set_address_error_trap(); /* auto-disable (see m68kcpu.h) */
 
@@ -665,13 +716,63 @@ int32_t m68k_execute(int32_t num_cycles)
          /* Call external hook to peek at CPU */
          m68ki_instr_hook(); /* auto-disable (see m68kcpu.h) */
 
+#if M68K_TRANSLATE
+         /* Run recompiled code if there is any for this PC */
+         if(m68ki_translate_run())
+            continue;
+#endif /* M68K_TRANSLATE */
+
          /* Record previous program counter */
          REG_PPC = REG_PC;
 
+#if M68K_PREDECODE_CACHE
+         /* Use the predecoded instruction if the memory under it hasnt changed */
+         {
+            m68ki_predecoded_t* entry = &m68ki_predecode_cache[(REG_PC >> 1) & (M68K_PREDECODE_CACHE_SIZE - 1)];
+            void (*handler)(void);
+            uint cycles;
+
+            if(entry->pc == REG_PC && *entry->generation == entry->generation_snapshot)
+            {
+               REG_PC += 2;
+               REG_IR = entry->ir;
+               handler = entry->handler;
+               cycles = entry->cycles;
+            }
+            else
+            {
+               uint pc = REG_PC;
+               uint32* generation;
+
+               REG_IR = m68ki_read_imm_16();
+               handler = m68ki_instruction_jump_table[REG_IR];
+               cycles = CYC_INSTRUCTION[REG_IR];
+
+               generation = M68K_GET_CODE_GENERATION(pc);
+               if(generation)
+               {
+                  /* odd generations mean the host is watching the memory for writes */
+                  if(!(*generation & 1))
+                     (*generation)++;
+                  entry->pc = pc;
+                  entry->generation = generation;
+                  entry->generation_snapshot = *generation;
+                  entry->handler = handler;
+                  entry->ir = REG_IR;
+                  entry->cycles = cycles;
+               }
+            }
+
+            /* the handler may flush the cache, only use the local copies from here on */
+            handler();
+            USE_CYCLES(cycles);
+         }
+#else
          /* Read an instruction and call its handler */
          REG_IR = m68ki_read_imm_16();
          m68ki_instruction_jump_table[REG_IR]();
          USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+#endif /* M68K_PREDECODE_CACHE */
 
          /* Trace m68k_exception, if necessary */
          m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
@@ -693,6 +794,66 @@ int32_t m68k_execute(int32_t num_cycles)
 }
 
 
+void m68k_flush_predecode_cache(void)
+{
+#if M68K_PREDECODE_CACHE
+   uint index;
+
+   for(index = 0; index < M68K_PREDECODE_CACHE_SIZE; index++)
+   {
+      m68ki_predecode_cache[index].pc = 0xFFFFFFFF;
+      m68ki_predecode_cache[index].generation = &m68ki_predecode_dead_generation;
+      m68ki_predecode_cache[index].generation_snapshot = 1;
+   }
+#endif /* M68K_PREDECODE_CACHE */
+#if M68K_TRANSLATE
+   m68ki_translate_flush();
+#endif /* M68K_TRANSLATE */
+}
+
+
+#if M68K_IDLE_LOOP_DETECT
+static void m68ki_idle_loop_save(m68ki_idle_state_t* state)
+{
+   memcpy(state->dar, REG_DA, sizeof(state->dar));
+   state->x_flag = FLAG_X;
+   state->n_flag = FLAG_N;
+   state->not_z_flag = FLAG_Z;
+   state->v_flag = FLAG_V;
+   state->c_flag = FLAG_C;
+   state->s_flag = FLAG_S;
+   state->int_mask = FLAG_INT_MASK;
+}
+
+void m68ki_idle_loop_check(void)
+{
+   m68ki_idle_state_t state;
+
+   if(REG_PC != m68ki_idle_pc)
+   {
+      m68ki_idle_pc = REG_PC;
+      m68ki_idle_count = 0;
+      return;
+   }
+
+   m68ki_idle_count++;
+   if(m68ki_idle_count == M68K_IDLE_LOOP_ARM_COUNT)
+   {
+      m68ki_idle_loop_save(&m68ki_idle_snapshot);
+      M68K_IDLE_LOOP_ARM();
+   }
+   else if(m68ki_idle_count > M68K_IDLE_LOOP_ARM_COUNT)
+   {
+      /* start over whatever happens, a busy loop only pays for a compare every few iterations */
+      m68ki_idle_count = 0;
+      m68ki_idle_loop_save(&state);
+      if(memcmp(&state, &m68ki_idle_snapshot, sizeof(state)) == 0 && M68K_IDLE_LOOP_CALLBACK(REG_PC))
+         m68k_end_timeslice();
+   }
+}
+#endif /* M68K_IDLE_LOOP_DETECT */
+
+
 int32_t m68k_cycles_run(void)
 {
    return m68ki_initial_cycles - GET_CYCLES();
@@ -713,7 +874,8 @@ void m68k_modify_timeslice(int32_t cycles)
 
 void m68k_end_timeslice(void)
 {
-   m68ki_initial_cycles = GET_CYCLES();
+   /* keep m68k_cycles_run() counting the cycles used so far */
+   m68ki_initial_cycles -= GET_CYCLES();
    SET_CYCLES(0);
 }
 
@@ -752,6 +914,8 @@ void m68k_init(void)
    m68k_set_pc_changed_callback(NULL);
    m68k_set_fc_callback(NULL);
    m68k_set_instr_hook_callback(NULL);
+
+   m68k_flush_predecode_cache();
 }
 
 /* Pulse the RESET line on the CPU */
@@ -774,7 +938,8 @@ void m68k_pulse_reset(void)
    /* Go to supervisor mode */
    m68ki_set_sm_flag(SFLAG_SET | MFLAG_CLEAR);
 
-   /* Invalidate the prefetch queue */
+   /* Invalidate the prefetch queue and predecoded instructions */
+   m68k_flush_predecode_cache();
 #if M68K_EMULATE_PREFETCH
    /* Set to arbitrary number since our first fetch is from 0 */
    CPU_PREF_ADDR = 0x1000;
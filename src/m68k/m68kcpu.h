@@ -951,9 +951,19 @@ MUSASHI_INLINE void m68ki_exception_address_error(void);
 MUSASHI_INLINE void m68ki_exception_interrupt(uint int_level);
 MUSASHI_INLINE void m68ki_check_interrupts(void);            /* ASG: check for interrupts */
 
+#if M68K_IDLE_LOOP_DETECT
+void m68ki_idle_loop_check(void);                          /* REG_PC is the target of a short backward branch */
+#endif /* M68K_IDLE_LOOP_DETECT */
+
 /* quick disassembly (used for logging) */
 char* m68ki_disassemble_quick(uint32_t pc, uint32_t cpu_type);
 
+#if M68K_TRANSLATE
+/* Recompiler (m68ktranslate_x86_64.c) */
+int  m68ki_translate_run(void);                         /* run the block at PC, 0 if there is none */
+void m68ki_translate_flush(void);                       /* forget all blocks */
+#endif /* M68K_TRANSLATE */
+
 
 /* ======================================================================== */
 /* =========================== UTILITY FUNCTIONS ========================== */
@@ -1333,11 +1343,19 @@ MUSASHI_INLINE void m68ki_jump_vector(uint vector)
 MUSASHI_INLINE void m68ki_branch_8(uint offset)
 {
    REG_PC += MAKE_INT_8(offset);
+#if M68K_IDLE_LOOP_DETECT
+   if(MAKE_INT_8(offset) < 0 && MAKE_INT_8(offset) >= -M68K_IDLE_LOOP_SIZE)
+      m68ki_idle_loop_check();
+#endif /* M68K_IDLE_LOOP_DETECT */
 }
 
 MUSASHI_INLINE void m68ki_branch_16(uint offset)
 {
    REG_PC += MAKE_INT_16(offset);
+#if M68K_IDLE_LOOP_DETECT
+   if(MAKE_INT_16(offset) < 0 && MAKE_INT_16(offset) >= -M68K_IDLE_LOOP_SIZE)
+      m68ki_idle_loop_check();
+#endif /* M68K_IDLE_LOOP_DETECT */
 }
 
 MUSASHI_INLINE void m68ki_branch_32(uint offset)
@@ -2,10 +2,15 @@
 #define M68KEXTERNAL_HEADER
 
 #include <stdint.h>
+#include <stdbool.h>
 
 int32_t interruptAcknowledge(int32_t intLevel);
 void emulatorSoftReset(void);
 void flx68000PcLongJump(uint32_t newPc);
+uint32_t* flx68000GetCodeGeneration(uint32_t address);
+void flx68000IdleLoopArm(void);
+bool flx68000IdleLoop(uint32_t pc);
+bool flx68000Trap(uint8_t vector);
 void sandboxOnOpcodeRun(void);
 
 #endif
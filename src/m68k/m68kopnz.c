@@ -7547,6 +7547,12 @@ void m68k_op_tas_8_al(void)
 
 void m68k_op_trap(void)
 {
+#if M68K_TRAP_HOOK == OPT_SPECIFY_HANDLER
+   /* The host may have already done what the trap would do */
+   if(M68K_TRAP_CALLBACK(REG_IR & 0xf))
+      return;
+#endif
+
    /* Trap#n stacks exception frame type 0 */
    m68ki_exception_trapN(EXCEPTION_TRAP_BASE + (REG_IR & 0xf));	/* HJB 990403 */
 }
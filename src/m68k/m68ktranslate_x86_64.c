@@ -0,0 +1,1698 @@
+/* ======================================================================== */
+/* ================================= NOTES ================================ */
+/* ======================================================================== */
+/*
+ * Recompiles runs of common 68000 instructions into x86_64 code.
+ *
+ * Blocks start at the PC m68k_execute() is about to run and end at the first
+ * instruction that is not handled here, at a change of flow, or at the end of
+ * the code generation page they started in, so one M68K_GET_CODE_GENERATION()
+ * counter covers the whole block.
+ * Everything not handled here is left to the interpreter, a block simply
+ * stores the PC of the instruction it cant run and returns.
+ *
+ * Register usage inside a block:
+ * rbx = &m68ki_cpu, all 68k state is read and written in place
+ * edi/esi = address/value passed to the memory handlers
+ * r12d = value that must survive a memory handler call
+ * eax, ecx, edx = scratch
+ *
+ * Instructions that call a memory handler store PPC, PC and IR first and
+ * leave the block afterwards if an exception moved the PC, the memory under
+ * the block was written or the memory map changed.
+ * Cycles are counted exactly like the interpreter does, after every
+ * instruction.
+ */
+
+
+/* ======================================================================== */
+/* ================================ INCLUDES ============================== */
+/* ======================================================================== */
+
+#include <string.h>
+
+#include "m68kops.h"
+#include "m68kcpu.h"
+
+#if M68K_TRANSLATE
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+/* ======================================================================== */
+/* ============================ CONFIGURATION ============================= */
+/* ======================================================================== */
+
+#define M68K_TRANSLATE_CACHE_SIZE       0x4000   /* blocks, must be a power of 2 */
+#define M68K_TRANSLATE_BUFFER_SIZE      0x400000 /* bytes of host code */
+#define M68K_TRANSLATE_BLOCK_MARGIN     0x2000   /* host code a single block can produce */
+#define M68K_TRANSLATE_MAX_INSTRUCTIONS 64       /* per block */
+
+
+/* ======================================================================== */
+/* ================================= DATA ================================= */
+/* ======================================================================== */
+
+typedef struct
+{
+   uint    pc;                  /* PC of the first instruction */
+   uint32* generation;          /* host counter for the memory holding the block */
+   uint32  generation_snapshot; /* value of *generation when the block was translated */
+   uint8*  code;                /* host code, NULL if the first instruction is interpreted */
+} m68ki_translation_t;
+
+enum
+{
+   TRANSLATE_UNSUPPORTED = 0,
+   TRANSLATE_CONTINUE,
+   TRANSLATE_END
+};
+
+static m68ki_translation_t m68ki_translate_cache[M68K_TRANSLATE_CACHE_SIZE];
+static uint32 m68ki_translate_dead_generation = 0; /* never matches a snapshot of 1 */
+
+static uint8* m68ki_translate_buffer = NULL;
+static uint8* m68ki_translate_buffer_end;
+static uint8* m68ki_translate_exit;              /* shared block exit */
+static void   (*m68ki_translate_enter)(uint8* code);
+static uint   m68ki_translate_initialized = 0;   /* 0 = not tried, 1 = ready, 2 = host refused */
+static uint   m68ki_translate_reset_pending = 0; /* all blocks are dead, reuse the buffer */
+static uint   m68ki_translate_pc_base_stale = 0; /* blocks dont call the PC changed callback */
+static uint   m68ki_translate_abort = 0;         /* memory map changed while a block was running */
+
+/* Offsets of globals from &m68ki_cpu, so blocks can reach them through rbx */
+static int offset_cycles;
+static int offset_abort;
+
+/* State of the block being translated */
+static uint8*  out;               /* next byte of host code */
+static uint8*  block_code;
+static uint    block_pc;
+static uint32* block_generation;
+static uint32  block_generation_snapshot;
+static uint    block_page_end;
+static uint    fetch_pc;          /* next word of the opcode stream */
+static uint    fetch_overrun;     /* an instruction runs past block_page_end */
+static uint    insn_pc;
+static uint    insn_ir;
+static uint    insn_next_pc;
+static uint    insn_calls;        /* the instruction calls a memory handler */
+
+#define CPU_OFFSET(FIELD) ((int)((uint8*)&m68ki_cpu.FIELD - (uint8*)&m68ki_cpu))
+#define OFFSET_D(N)       CPU_OFFSET(dar[N])
+#define OFFSET_A(N)       CPU_OFFSET(dar[8 + (N)])
+#define OFFSET_PC         CPU_OFFSET(pc)
+#define OFFSET_PPC        CPU_OFFSET(ppc)
+#define OFFSET_IR         CPU_OFFSET(ir)
+#define OFFSET_X          CPU_OFFSET(x_flag)
+#define OFFSET_N          CPU_OFFSET(n_flag)
+#define OFFSET_Z          CPU_OFFSET(not_z_flag)
+#define OFFSET_V          CPU_OFFSET(v_flag)
+#define OFFSET_C          CPU_OFFSET(c_flag)
+
+#if M68K_SEPARATE_READS
+#define m68ki_translate_read_16(A) m68k_read_immediate_16(ADDRESS_68K(A))
+#else
+#define m68ki_translate_read_16(A) m68k_read_memory_16(ADDRESS_68K(A))
+#endif
+
+
+/* ======================================================================== */
+/* ============================ X86_64 EMITTER ============================ */
+/* ======================================================================== */
+
+enum x86_reg { EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI, R12D = 12 };
+enum x86_reg8 { AL, CL, DL, BL, AH, CH, DH, BH };
+enum x86_group1 { X86_ADD, X86_OR, X86_ADC, X86_SBB, X86_AND, X86_SUB, X86_XOR, X86_CMP };
+enum x86_group2 { X86_ROL, X86_ROR, X86_RCL, X86_RCR, X86_SHL, X86_SHR, X86_SAL, X86_SAR };
+enum x86_group3 { X86_NOT = 2, X86_NEG };
+enum x86_cc { CC_O, CC_NO, CC_B, CC_AE, CC_Z, CC_NZ, CC_BE, CC_A, CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G };
+
+static void emit_byte(uint8 value)
+{
+   *out++ = value;
+}
+
+static void emit_word(uint16 value)
+{
+   memcpy(out, &value, 2);
+   out += 2;
+}
+
+static void emit_dword(uint32 value)
+{
+   memcpy(out, &value, 4);
+   out += 4;
+}
+
+static void emit_qword(uint64_t value)
+{
+   memcpy(out, &value, 8);
+   out += 8;
+}
+
+/* r, [rbx + offset] */
+static void emit_modrm_cpu(int r, int offset)
+{
+   if(offset >= -128 && offset < 128)
+   {
+      emit_byte(0x40 | (r & 7) << 3 | EBX);
+      emit_byte(offset);
+   }
+   else
+   {
+      emit_byte(0x80 | (r & 7) << 3 | EBX);
+      emit_dword(offset);
+   }
+}
+
+static void emit_modrm_reg(int r, int rm)
+{
+   emit_byte(0xC0 | (r & 7) << 3 | (rm & 7));
+}
+
+/* 16 bit operand size prefix */
+static void emit_size_prefix(uint size)
+{
+   if(size == 2)
+      emit_byte(0x66);
+}
+
+/* mov r32, [rbx + offset] */
+static void emit_load(int r, int offset)
+{
+   if(r & 8)
+      emit_byte(0x44);
+   emit_byte(0x8B);
+   emit_modrm_cpu(r, offset);
+}
+
+/* movzx r32, size [rbx + offset] */
+static void emit_load_zx(int r, int offset, uint size)
+{
+   if(size == 4)
+   {
+      emit_load(r, offset);
+      return;
+   }
+   emit_byte(0x0F);
+   emit_byte(size == 1 ? 0xB6 : 0xB7);
+   emit_modrm_cpu(r, offset);
+}
+
+/* movsx r32, size [rbx + offset] */
+static void emit_load_sx(int r, int offset, uint size)
+{
+   if(size == 4)
+   {
+      emit_load(r, offset);
+      return;
+   }
+   emit_byte(0x0F);
+   emit_byte(size == 1 ? 0xBE : 0xBF);
+   emit_modrm_cpu(r, offset);
+}
+
+/* mov size [rbx + offset], r */
+static void emit_store(int offset, int r, uint size)
+{
+   emit_size_prefix(size);
+   if(r & 8)
+      emit_byte(0x44);
+   emit_byte(size == 1 ? 0x88 : 0x89);
+   emit_modrm_cpu(r, offset);
+}
+
+/* mov dword [rbx + offset], imm32 */
+static void emit_store_imm(int offset, uint32 value)
+{
+   emit_byte(0xC7);
+   emit_modrm_cpu(0, offset);
+   emit_dword(value);
+}
+
+/* mov r32, imm32 */
+static void emit_mov_imm(int r, uint32 value)
+{
+   emit_byte(0xB8 + r);
+   emit_dword(value);
+}
+
+/* mov r32, r32 */
+static void emit_mov(int dst, int src)
+{
+   if((dst | src) & 8)
+      emit_byte(0x40 | (src & 8) >> 1 | (dst & 8) >> 3);
+   emit_byte(0x89);
+   emit_modrm_reg(src, dst);
+}
+
+/* movzx/movsx r32, r8/r16 */
+static void emit_extend(int dst, int src, uint size, int sign)
+{
+   if(size == 4)
+   {
+      if(dst != src)
+         emit_mov(dst, src);
+      return;
+   }
+   emit_byte(0x0F);
+   emit_byte((sign ? 0xBE : 0xB6) | (size == 2));
+   emit_modrm_reg(dst, src);
+}
+
+/* op size dst, src */
+static void emit_alu(int op, uint size, int dst, int src)
+{
+   emit_size_prefix(size);
+   emit_byte(op << 3 | (size != 1));
+   emit_modrm_reg(src, dst);
+}
+
+/* op size r, imm */
+static void emit_alu_imm(int op, uint size, int r, uint32 value)
+{
+   if(r & 8)
+   {
+      /* only needed for r12d address arithmetic */
+      emit_byte(0x41);
+      size = 4;
+   }
+   emit_size_prefix(size);
+   if(size == 1)
+   {
+      emit_byte(0x80);
+      emit_modrm_reg(op, r);
+      emit_byte(value);
+   }
+   else if((sint32)value >= -128 && (sint32)value < 128)
+   {
+      emit_byte(0x83);
+      emit_modrm_reg(op, r);
+      emit_byte(value);
+   }
+   else
+   {
+      emit_byte(0x81);
+      emit_modrm_reg(op, r);
+      if(size == 2)
+         emit_word(value);
+      else
+         emit_dword(value);
+   }
+}
+
+/* op dword [rbx + offset], imm */
+static void emit_alu_cpu_imm(int op, int offset, uint32 value)
+{
+   if((sint32)value >= -128 && (sint32)value < 128)
+   {
+      emit_byte(0x83);
+      emit_modrm_cpu(op, offset);
+      emit_byte(value);
+   }
+   else
+   {
+      emit_byte(0x81);
+      emit_modrm_cpu(op, offset);
+      emit_dword(value);
+   }
+}
+
+/* op r32, dword [rbx + offset] */
+static void emit_alu_load(int op, int r, int offset)
+{
+   emit_byte(op << 3 | 3);
+   emit_modrm_cpu(r, offset);
+}
+
+/* op dword [rbx + offset], r32 */
+static void emit_alu_store(int op, int offset, int r)
+{
+   emit_byte(op << 3 | 1);
+   emit_modrm_cpu(r, offset);
+}
+
+/* shift size r, count */
+static void emit_shift(int op, uint size, int r, uint count)
+{
+   emit_size_prefix(size);
+   emit_byte(size == 1 ? 0xC0 : 0xC1);
+   emit_modrm_reg(op, r);
+   emit_byte(count);
+}
+
+/* not/neg size r */
+static void emit_unary(int op, uint size, int r)
+{
+   emit_size_prefix(size);
+   emit_byte(size == 1 ? 0xF6 : 0xF7);
+   emit_modrm_reg(op, r);
+}
+
+/* test dword [rbx + offset], imm32 */
+static void emit_test_cpu_imm(int offset, uint32 value)
+{
+   emit_byte(0xF7);
+   emit_modrm_cpu(0, offset);
+   emit_dword(value);
+}
+
+/* setcc r8 */
+static void emit_setcc(int cc, int r8)
+{
+   emit_byte(0x0F);
+   emit_byte(0x90 | cc);
+   emit_modrm_reg(0, r8);
+}
+
+/* jcc rel32 to a known location */
+static void emit_jcc_to(int cc, uint8* target)
+{
+   emit_byte(0x0F);
+   emit_byte(0x80 | cc);
+   emit_dword(target - (out + 4));
+}
+
+/* jmp rel32 to a known location */
+static void emit_jmp_to(uint8* target)
+{
+   emit_byte(0xE9);
+   emit_dword(target - (out + 4));
+}
+
+/* jcc rel32 to a location emitted later, returns the displacement to patch */
+static uint8* emit_jcc_forward(int cc)
+{
+   emit_byte(0x0F);
+   emit_byte(0x80 | cc);
+   emit_dword(0);
+   return out - 4;
+}
+
+static uint8* emit_jmp_forward(void)
+{
+   emit_byte(0xE9);
+   emit_dword(0);
+   return out - 4;
+}
+
+/* point a forward jump at the current location */
+static void patch_forward(uint8* displacement)
+{
+   sint32 value = out - (displacement + 4);
+
+   memcpy(displacement, &value, 4);
+}
+
+/* call a C function, all scratch registers are lost */
+static void emit_call(void* function)
+{
+   /* mov rax, function */
+   emit_byte(0x48);
+   emit_byte(0xB8);
+   emit_qword((uintptr_t)function);
+   /* call rax */
+   emit_byte(0xFF);
+   emit_byte(0xD0);
+}
+
+
+/* ======================================================================== */
+/* =========================== 68K HELPERS ================================ */
+/* ======================================================================== */
+
+static uint fetch_16(void)
+{
+   uint value;
+
+   if(fetch_pc + 2 > block_page_end)
+   {
+      fetch_overrun = 1;
+      return 0;
+   }
+   value = m68ki_translate_read_16(fetch_pc);
+   fetch_pc += 2;
+   return value;
+}
+
+static uint fetch_32(void)
+{
+   uint high = fetch_16();
+   uint low = fetch_16();
+
+   return high << 16 | low;
+}
+
+static uint size_mask(uint size)
+{
+   return size == 4 ? 0xFFFFFFFF : (1 << size * 8) - 1;
+}
+
+/* Musashi shift for NFLAG_8/16/32 */
+static uint size_n_shift(uint size)
+{
+   return size == 4 ? 24 : size == 2 ? 8 : 0;
+}
+
+/* bytes of extension words used by an effective address */
+static uint ea_extension_size(uint mode, uint reg, uint size)
+{
+   switch(mode)
+   {
+      case 5:
+      case 6:
+         return 2;
+      case 7:
+         switch(reg)
+         {
+            case 0:
+            case 2:
+            case 3:
+               return 2;
+            case 1:
+               return 4;
+            case 4:
+               return size == 4 ? 4 : 2;
+         }
+   }
+   return 0;
+}
+
+/* the effective address is in memory */
+static int ea_is_memory(uint mode, uint reg)
+{
+   return mode >= 2 && !(mode == 7 && reg == 4);
+}
+
+/* the effective address can be translated, the opcode table has already ruled out invalid ones */
+static int ea_is_supported(uint mode, uint reg)
+{
+   return mode < 7 || reg <= 4;
+}
+
+/* Set up PPC, PC and IR the way the interpreter has them while an opcode handler runs */
+static void begin_instruction(uint length, uint calls)
+{
+   insn_next_pc = insn_pc + length;
+   insn_calls = calls;
+   if(calls)
+   {
+      emit_store_imm(OFFSET_PPC, insn_pc);
+      emit_store_imm(OFFSET_PC, insn_next_pc);
+      emit_store_imm(OFFSET_IR, insn_ir);
+   }
+}
+
+/* Charge cycles and leave the block if they ran out or the memory handlers changed something */
+static void end_instruction(sint cycles)
+{
+   emit_alu_cpu_imm(X86_SUB, offset_cycles, cycles);
+   if(insn_calls)
+   {
+      /* PC is already insn_next_pc unless an exception was taken */
+      emit_alu_cpu_imm(X86_CMP, OFFSET_PC, insn_next_pc);
+      emit_jcc_to(CC_NZ, m68ki_translate_exit);
+      emit_alu_cpu_imm(X86_CMP, offset_abort, 0);
+      emit_jcc_to(CC_NZ, m68ki_translate_exit);
+      /* mov rax, block_generation; cmp dword [rax], snapshot */
+      emit_byte(0x48);
+      emit_byte(0xB8);
+      emit_qword((uintptr_t)block_generation);
+      emit_byte(0x81);
+      emit_byte(0x38);
+      emit_dword(block_generation_snapshot);
+      emit_jcc_to(CC_NZ, m68ki_translate_exit);
+      emit_alu_cpu_imm(X86_CMP, offset_cycles, 0);
+      emit_jcc_to(CC_LE, m68ki_translate_exit);
+   }
+   else
+   {
+      uint8* next = out;
+
+      /* jg next, patched below */
+      emit_byte(0x70 | CC_G);
+      emit_byte(0);
+      emit_store_imm(OFFSET_PC, insn_next_pc);
+      emit_jmp_to(m68ki_translate_exit);
+      next[1] = out - (next + 2);
+   }
+}
+
+/* Charge cycles and go to a known PC, this always ends the block */
+static void end_instruction_branch(sint cycles, uint target)
+{
+   emit_alu_cpu_imm(X86_SUB, offset_cycles, cycles);
+   emit_store_imm(OFFSET_PC, target);
+#if M68K_IDLE_LOOP_DETECT
+   /* short backward branches are watched like m68ki_branch_8/16 do, the check may end the timeslice */
+   if((sint)(target - insn_pc - 2) < 0 && (sint)(target - insn_pc - 2) >= -M68K_IDLE_LOOP_SIZE)
+   {
+      emit_call((void*)m68ki_idle_loop_check);
+      emit_alu_cpu_imm(X86_CMP, offset_cycles, 0);
+   }
+#endif /* M68K_IDLE_LOOP_DETECT */
+   if(target == block_pc && !insn_calls)
+      emit_jcc_to(CC_G, block_code);
+   emit_jmp_to(m68ki_translate_exit);
+}
+
+/* Charge cycles and leave with PC as the instruction left it */
+static void end_instruction_jump(sint cycles)
+{
+   emit_alu_cpu_imm(X86_SUB, offset_cycles, cycles);
+   emit_jmp_to(m68ki_translate_exit);
+}
+
+static void emit_memory_call(void* function)
+{
+   if(CPU_ADDRESS_MASK != 0xFFFFFFFF)
+      emit_alu_imm(X86_AND, 4, EDI, CPU_ADDRESS_MASK);
+   emit_call(function);
+}
+
+/* eax = size [edi], zero extended */
+static void emit_read(uint size)
+{
+   emit_memory_call(size == 1 ? (void*)m68k_read_memory_8 : size == 2 ? (void*)m68k_read_memory_16 : (void*)m68k_read_memory_32);
+   emit_extend(EAX, EAX, size, 0);
+}
+
+/* size [edi] = esi */
+static void emit_write(uint size)
+{
+   emit_memory_call(size == 1 ? (void*)m68k_write_memory_8 : size == 2 ? (void*)m68k_write_memory_16 : (void*)m68k_write_memory_32);
+}
+
+/* edi = effective address, applying (An)+ and -(An), only eax is used as scratch */
+static void emit_ea_address(uint mode, uint reg, uint size)
+{
+   uint step = (size == 1 && reg == 7) ? 2 : size;
+   uint base = 0;
+   uint extension;
+
+   switch(mode)
+   {
+      case 2:
+         emit_load(EDI, OFFSET_A(reg));
+         return;
+      case 3:
+         emit_load(EDI, OFFSET_A(reg));
+         emit_alu_cpu_imm(X86_ADD, OFFSET_A(reg), step);
+         return;
+      case 4:
+         emit_alu_cpu_imm(X86_SUB, OFFSET_A(reg), step);
+         emit_load(EDI, OFFSET_A(reg));
+         return;
+      case 5:
+         emit_load(EDI, OFFSET_A(reg));
+         extension = MAKE_INT_16(fetch_16());
+         if(extension)
+            emit_alu_imm(X86_ADD, 4, EDI, extension);
+         return;
+      case 6:
+         emit_load(EDI, OFFSET_A(reg));
+         break;
+      case 7:
+         switch(reg)
+         {
+            case 0:
+               emit_mov_imm(EDI, MAKE_INT_16(fetch_16()));
+               return;
+            case 1:
+               emit_mov_imm(EDI, fetch_32());
+               return;
+            case 2:
+               base = fetch_pc;
+               emit_mov_imm(EDI, base + MAKE_INT_16(fetch_16()));
+               return;
+            case 3:
+               base = fetch_pc;
+               break;
+         }
+         break;
+   }
+
+   /* (d8,An,Xn) and (d8,PC,Xn), 68000 brief extension word */
+   extension = fetch_16();
+   if(mode == 7)
+      emit_mov_imm(EDI, base + MAKE_INT_8(extension));
+   else if(MAKE_INT_8(extension))
+      emit_alu_imm(X86_ADD, 4, EDI, MAKE_INT_8(extension));
+   if(BIT_B(extension))
+      emit_load(EAX, OFFSET_D(extension >> 12));
+   else
+      emit_load_sx(EAX, OFFSET_D(extension >> 12), 2);
+   emit_alu(X86_ADD, 4, EDI, EAX);
+}
+
+/* eax = operand, zero extended */
+static void emit_read_ea(uint mode, uint reg, uint size)
+{
+   switch(mode)
+   {
+      case 0:
+         emit_load_zx(EAX, OFFSET_D(reg), size);
+         return;
+      case 1:
+         emit_load_zx(EAX, OFFSET_A(reg), size);
+         return;
+      case 7:
+         if(reg == 4)
+         {
+            if(size == 4)
+               emit_mov_imm(EAX, fetch_32());
+            else
+               emit_mov_imm(EAX, fetch_16() & size_mask(size));
+            return;
+         }
+         break;
+   }
+   emit_ea_address(mode, reg, size);
+   emit_read(size);
+}
+
+/* Musashi flags for a move or logical result held zero extended in r */
+static void emit_flags_logic(int r, uint size)
+{
+   int scratch = r == ECX ? EAX : ECX;
+
+   emit_store(OFFSET_Z, r, 4);
+   emit_mov(scratch, r);
+   if(size_n_shift(size))
+      emit_shift(X86_SHR, 4, scratch, size_n_shift(size));
+   emit_store(OFFSET_N, scratch, 4);
+   emit_store_imm(OFFSET_V, VFLAG_CLEAR);
+   emit_store_imm(OFFSET_C, CFLAG_CLEAR);
+}
+
+enum
+{
+   FLAGS_ARITH,   /* NZVC from the host, X = C */
+   FLAGS_COMPARE, /* NZVC from the host */
+   FLAGS_SHIFT    /* NZC from the host, X = C, V clear */
+};
+
+/* Capture the host flags of a size operation on edx into the 68k flags */
+static void emit_flags_host(uint size, int kind)
+{
+   if(kind != FLAGS_SHIFT)
+      emit_setcc(CC_O, AL);
+   emit_setcc(CC_S, AH);
+   emit_setcc(CC_B, CL);
+
+   if(kind != FLAGS_SHIFT)
+   {
+      emit_extend(ESI, AL, 1, 0);
+      emit_shift(X86_SHL, 4, ESI, 7);
+      emit_store(OFFSET_V, ESI, 4);
+   }
+   else
+   {
+      emit_store_imm(OFFSET_V, VFLAG_CLEAR);
+   }
+   emit_extend(ESI, AH, 1, 0);
+   emit_shift(X86_SHL, 4, ESI, 7);
+   emit_store(OFFSET_N, ESI, 4);
+   emit_extend(ESI, CL, 1, 0);
+   emit_shift(X86_SHL, 4, ESI, 8);
+   emit_store(OFFSET_C, ESI, 4);
+   if(kind != FLAGS_COMPARE)
+      emit_store(OFFSET_X, ESI, 4);
+   emit_extend(ESI, EDX, size, 0);
+   emit_store(OFFSET_Z, ESI, 4);
+}
+
+/* al = condition is true, then test al, al */
+static void emit_condition(uint condition)
+{
+   switch(condition)
+   {
+      case 2: /* HI */
+      case 3: /* LS */
+         emit_test_cpu_imm(OFFSET_C, 0x100);
+         emit_setcc(condition == 2 ? CC_Z : CC_NZ, AL);
+         emit_alu_cpu_imm(X86_CMP, OFFSET_Z, 0);
+         emit_setcc(condition == 2 ? CC_NZ : CC_Z, CL);
+         emit_alu(condition == 2 ? X86_AND : X86_OR, 1, AL, CL);
+         break;
+      case 4: /* CC */
+      case 5: /* CS */
+         emit_test_cpu_imm(OFFSET_C, 0x100);
+         emit_setcc(condition == 4 ? CC_Z : CC_NZ, AL);
+         break;
+      case 6: /* NE */
+      case 7: /* EQ */
+         emit_alu_cpu_imm(X86_CMP, OFFSET_Z, 0);
+         emit_setcc(condition == 6 ? CC_NZ : CC_Z, AL);
+         break;
+      case 8: /* VC */
+      case 9: /* VS */
+         emit_test_cpu_imm(OFFSET_V, 0x80);
+         emit_setcc(condition == 8 ? CC_Z : CC_NZ, AL);
+         break;
+      case 10: /* PL */
+      case 11: /* MI */
+         emit_test_cpu_imm(OFFSET_N, 0x80);
+         emit_setcc(condition == 10 ? CC_Z : CC_NZ, AL);
+         break;
+      default: /* GE, LT, GT, LE */
+         emit_load(EAX, OFFSET_N);
+         emit_alu_load(X86_XOR, EAX, OFFSET_V);
+         /* test eax, 0x80 */
+         emit_byte(0xA9);
+         emit_dword(0x80);
+         emit_setcc((condition == 12 || condition == 14) ? CC_Z : CC_NZ, AL);
+         if(condition >= 14)
+         {
+            emit_alu_cpu_imm(X86_CMP, OFFSET_Z, 0);
+            emit_setcc(condition == 14 ? CC_NZ : CC_Z, CL);
+            emit_alu(condition == 14 ? X86_AND : X86_OR, 1, AL, CL);
+         }
+         break;
+   }
+   emit_alu(X86_AND, 1, AL, AL);
+}
+
+/* SP -= 4, [SP] = r */
+static void emit_push_32(int r)
+{
+   if(r != ESI)
+      emit_mov(ESI, r);
+   emit_alu_cpu_imm(X86_SUB, OFFSET_A(7), 4);
+   emit_load(EDI, OFFSET_A(7));
+   emit_write(4);
+}
+
+
+/* ======================================================================== */
+/* ============================= INSTRUCTIONS ============================= */
+/* ======================================================================== */
+
+static int translate_move(void)
+{
+   static const uint sizes[4] = {0, 1, 4, 2};
+   uint size = sizes[(insn_ir >> 12) & 3];
+   uint src_mode = (insn_ir >> 3) & 7;
+   uint src_reg = insn_ir & 7;
+   uint dst_mode = (insn_ir >> 6) & 7;
+   uint dst_reg = (insn_ir >> 9) & 7;
+
+   if(!ea_is_supported(src_mode, src_reg) || (dst_mode == 7 && dst_reg > 1))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2 + ea_extension_size(src_mode, src_reg, size) + ea_extension_size(dst_mode, dst_reg, size), ea_is_memory(src_mode, src_reg) || ea_is_memory(dst_mode, dst_reg));
+   emit_read_ea(src_mode, src_reg, size);
+   switch(dst_mode)
+   {
+      case 0:
+         emit_store(OFFSET_D(dst_reg), EAX, size);
+         emit_flags_logic(EAX, size);
+         break;
+      case 1:
+         /* MOVEA */
+         emit_extend(EAX, EAX, size, 1);
+         emit_store(OFFSET_A(dst_reg), EAX, 4);
+         break;
+      default:
+         emit_mov(ESI, EAX);
+         emit_ea_address(dst_mode, dst_reg, size);
+         emit_mov(R12D, ESI);
+         emit_write(size);
+         emit_mov(EAX, R12D);
+         emit_flags_logic(EAX, size);
+         break;
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+static int translate_moveq(void)
+{
+   uint value = MAKE_INT_8(insn_ir & 0xFF);
+
+   begin_instruction(2, 0);
+   emit_store_imm(OFFSET_D((insn_ir >> 9) & 7), value);
+   emit_store_imm(OFFSET_N, NFLAG_32(value));
+   emit_store_imm(OFFSET_Z, value);
+   emit_store_imm(OFFSET_V, VFLAG_CLEAR);
+   emit_store_imm(OFFSET_C, CFLAG_CLEAR);
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* size Dn op= eax, flags as the operation needs */
+static void emit_data_op(int op, uint size, uint reg)
+{
+   emit_mov(ECX, EAX);
+   emit_load_zx(EDX, OFFSET_D(reg), size);
+   /* compares subtract from a copy, Z needs the result */
+   emit_alu(op == X86_CMP ? X86_SUB : op, size, EDX, ECX);
+   if(op == X86_ADD || op == X86_SUB)
+   {
+      emit_flags_host(size, FLAGS_ARITH);
+   }
+   else if(op == X86_CMP)
+   {
+      emit_flags_host(size, FLAGS_COMPARE);
+      return;
+   }
+   else
+   {
+      emit_flags_logic(EDX, size);
+   }
+   emit_store(OFFSET_D(reg), EDX, size);
+}
+
+/* ADD, SUB, AND, OR, CMP <ea>,Dn and EOR Dn,Dn */
+static int translate_data_op(int op)
+{
+   uint size = 1 << ((insn_ir >> 6) & 3);
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint dst = (insn_ir >> 9) & 7;
+
+   if(op == X86_XOR)
+   {
+      /* EOR Dn,Dn only */
+      if(mode != 0)
+         return TRANSLATE_UNSUPPORTED;
+      begin_instruction(2, 0);
+      emit_load_zx(EAX, OFFSET_D(dst), size);
+      emit_data_op(op, size, reg);
+   }
+   else
+   {
+      if(insn_ir & 0x0100 || !ea_is_supported(mode, reg))
+         return TRANSLATE_UNSUPPORTED;
+      begin_instruction(2 + ea_extension_size(mode, reg, size), ea_is_memory(mode, reg));
+      emit_read_ea(mode, reg, size);
+      emit_data_op(op, size, dst);
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* ADDA, SUBA, CMPA */
+static int translate_address_op(int op)
+{
+   uint size = (insn_ir & 0x0100) ? 4 : 2;
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint dst = (insn_ir >> 9) & 7;
+
+   if(!ea_is_supported(mode, reg))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2 + ea_extension_size(mode, reg, size), ea_is_memory(mode, reg));
+   emit_read_ea(mode, reg, size);
+   emit_extend(EAX, EAX, size, 1);
+   if(op == X86_CMP)
+   {
+      emit_load(EDX, OFFSET_A(dst));
+      emit_alu(X86_SUB, 4, EDX, EAX);
+      emit_flags_host(4, FLAGS_COMPARE);
+   }
+   else
+   {
+      emit_alu_store(op, OFFSET_A(dst), EAX);
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* ORI, ANDI, SUBI, ADDI, EORI, CMPI to Dn, and CMPI to memory */
+static int translate_immediate_op(void)
+{
+   static const int ops[8] = {X86_OR, X86_AND, X86_SUB, X86_ADD, -1, X86_XOR, X86_CMP, -1};
+   int op = ops[(insn_ir >> 9) & 7];
+   uint size = 1 << ((insn_ir >> 6) & 3);
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint value;
+
+   if(op < 0 || (mode != 0 && (op != X86_CMP || !ea_is_memory(mode, reg) || !ea_is_supported(mode, reg))))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2 + (size == 4 ? 4 : 2) + ea_extension_size(mode, reg, size), mode != 0);
+   value = size == 4 ? fetch_32() : fetch_16() & size_mask(size);
+   if(mode == 0)
+   {
+      emit_mov_imm(EAX, value);
+      emit_data_op(op, size, reg);
+   }
+   else
+   {
+      emit_read_ea(mode, reg, size);
+      emit_mov(EDX, EAX);
+      emit_alu_imm(X86_SUB, size, EDX, value);
+      emit_flags_host(size, FLAGS_COMPARE);
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* ADDQ, SUBQ to Dn or An */
+static int translate_quick_op(void)
+{
+   uint size = 1 << ((insn_ir >> 6) & 3);
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint value = (((insn_ir >> 9) - 1) & 7) + 1;
+   int op = (insn_ir & 0x0100) ? X86_SUB : X86_ADD;
+
+   if(mode > 1)
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2, 0);
+   if(mode == 1)
+   {
+      emit_alu_cpu_imm(op, OFFSET_A(reg), value);
+   }
+   else
+   {
+      emit_mov_imm(EAX, value);
+      emit_data_op(op, size, reg);
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* LSL, LSR, ASR by an immediate count */
+static int translate_shift(void)
+{
+   uint size = 1 << ((insn_ir >> 6) & 3);
+   uint reg = insn_ir & 7;
+   uint count = (((insn_ir >> 9) - 1) & 7) + 1;
+   uint type = (insn_ir >> 3) & 3;
+   int left = insn_ir & 0x0100;
+   int op;
+
+   /* register counts, rotates, ASL and host shifts that leave the carry undefined stay interpreted */
+   if(insn_ir & 0x0020 || type > 1 || (type == 0 && left) || count >= size * 8)
+      return TRANSLATE_UNSUPPORTED;
+   op = left ? X86_SHL : type == 0 ? X86_SAR : X86_SHR;
+
+   begin_instruction(2, 0);
+   emit_load_zx(EDX, OFFSET_D(reg), size);
+   emit_shift(op, size, EDX, count);
+   emit_flags_host(size, FLAGS_SHIFT);
+   emit_store(OFFSET_D(reg), EDX, size);
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* BTST #n,<ea> */
+static int translate_btst(void)
+{
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint bit;
+
+   if(!ea_is_supported(mode, reg) || (mode == 7 && reg == 4))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(4 + ea_extension_size(mode, reg, 1), mode != 0);
+   bit = fetch_16();
+   if(mode == 0)
+   {
+      emit_load(EAX, OFFSET_D(reg));
+      emit_alu_imm(X86_AND, 4, EAX, 1 << (bit & 31));
+   }
+   else
+   {
+      emit_read_ea(mode, reg, 1);
+      emit_alu_imm(X86_AND, 4, EAX, 1 << (bit & 7));
+   }
+   emit_store(OFFSET_Z, EAX, 4);
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* CLR, NEG, NOT, TST */
+static int translate_unary(void)
+{
+   uint size = 1 << ((insn_ir >> 6) & 3);
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint type = (insn_ir >> 9) & 7;
+
+   if(type == 5)
+   {
+      /* TST */
+      if(!ea_is_supported(mode, reg))
+         return TRANSLATE_UNSUPPORTED;
+      begin_instruction(2 + ea_extension_size(mode, reg, size), ea_is_memory(mode, reg));
+      emit_read_ea(mode, reg, size);
+      emit_flags_logic(EAX, size);
+   }
+   else if(type == 1)
+   {
+      /* CLR */
+      if(!ea_is_supported(mode, reg))
+         return TRANSLATE_UNSUPPORTED;
+      begin_instruction(2 + ea_extension_size(mode, reg, size), mode != 0);
+      if(mode == 0)
+      {
+         emit_alu(X86_XOR, 4, EAX, EAX);
+         emit_store(OFFSET_D(reg), EAX, size);
+      }
+      else
+      {
+         emit_ea_address(mode, reg, size);
+         emit_alu(X86_XOR, 4, ESI, ESI);
+         emit_write(size);
+      }
+      emit_store_imm(OFFSET_N, NFLAG_CLEAR);
+      emit_store_imm(OFFSET_V, VFLAG_CLEAR);
+      emit_store_imm(OFFSET_C, CFLAG_CLEAR);
+      emit_store_imm(OFFSET_Z, ZFLAG_SET);
+   }
+   else if(type == 2 || type == 3)
+   {
+      /* NEG, NOT */
+      if(mode != 0)
+         return TRANSLATE_UNSUPPORTED;
+      begin_instruction(2, 0);
+      emit_load_zx(EDX, OFFSET_D(reg), size);
+      if(type == 2)
+      {
+         emit_unary(X86_NEG, size, EDX);
+         emit_flags_host(size, FLAGS_ARITH);
+      }
+      else
+      {
+         emit_unary(X86_NOT, size, EDX);
+         emit_flags_logic(EDX, size);
+      }
+      emit_store(OFFSET_D(reg), EDX, size);
+   }
+   else
+   {
+      return TRANSLATE_UNSUPPORTED;
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* SWAP, EXT.W, EXT.L */
+static int translate_swap_ext(void)
+{
+   uint reg = insn_ir & 7;
+
+   begin_instruction(2, 0);
+   switch((insn_ir >> 6) & 7)
+   {
+      case 1:
+         emit_load(EDX, OFFSET_D(reg));
+         /* rol edx, 16 */
+         emit_shift(X86_ROL, 4, EDX, 16);
+         emit_store(OFFSET_D(reg), EDX, 4);
+         emit_flags_logic(EDX, 4);
+         break;
+      case 2:
+         emit_load_sx(EDX, OFFSET_D(reg), 1);
+         emit_store(OFFSET_D(reg), EDX, 2);
+         emit_extend(EDX, EDX, 2, 0);
+         emit_flags_logic(EDX, 2);
+         break;
+      case 3:
+         emit_load_sx(EDX, OFFSET_D(reg), 2);
+         emit_store(OFFSET_D(reg), EDX, 4);
+         emit_flags_logic(EDX, 4);
+         break;
+   }
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* LEA, PEA */
+static int translate_effective_address(int push)
+{
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+
+   if(!ea_is_supported(mode, reg))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2 + ea_extension_size(mode, reg, 4), push);
+   emit_ea_address(mode, reg, 4);
+   if(push)
+      emit_push_32(EDI);
+   else
+      emit_store(OFFSET_A((insn_ir >> 9) & 7), EDI, 4);
+   end_instruction(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_CONTINUE;
+}
+
+/* MOVEM to and from memory */
+static int translate_movem(void)
+{
+   uint size = (insn_ir & 0x0040) ? 4 : 2;
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   int to_registers = insn_ir & 0x0400;
+   uint list;
+   uint count = 0;
+   uint i;
+
+   if(mode == 7 || mode == 6)
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(4 + ea_extension_size(mode, reg, size), 1);
+   list = fetch_16();
+   if(mode == 3 || mode == 4)
+      emit_load(EDI, OFFSET_A(reg));
+   else
+      emit_ea_address(mode, reg, size);
+   emit_mov(R12D, EDI);
+
+   for(i = 0; i < 16; i++)
+   {
+      if(!(list & (1 << i)))
+         continue;
+      if(mode == 4)
+      {
+         /* -(An) lists are reversed, An is only written back at the end */
+         emit_alu_imm(X86_SUB, 4, R12D, size);
+         emit_mov(EDI, R12D);
+         emit_load(ESI, OFFSET_D(15 - i));
+         emit_write(size);
+      }
+      else if(to_registers)
+      {
+         emit_mov(EDI, R12D);
+         emit_read(size);
+         emit_extend(EAX, EAX, size, 1);
+         emit_store(OFFSET_D(i), EAX, 4);
+         emit_alu_imm(X86_ADD, 4, R12D, size);
+      }
+      else
+      {
+         emit_mov(EDI, R12D);
+         emit_load(ESI, OFFSET_D(i));
+         emit_write(size);
+         emit_alu_imm(X86_ADD, 4, R12D, size);
+      }
+      count++;
+   }
+   if(mode == 3 || mode == 4)
+      emit_store(OFFSET_A(reg), R12D, 4);
+
+   end_instruction(CYC_INSTRUCTION[insn_ir] + (count << (size == 4 ? CYC_MOVEM_L : CYC_MOVEM_W)));
+   return TRANSLATE_CONTINUE;
+}
+
+/* BRA, BSR, Bcc */
+static int translate_branch(void)
+{
+   uint condition = (insn_ir >> 8) & 0xF;
+   uint displacement = insn_ir & 0xFF;
+   uint word = displacement == 0;
+   uint target;
+   uint8* not_taken = NULL;
+
+   /* a displacement of 0xFF is a 68020 long branch, the 68000 branches to an odd address */
+   if(displacement == 0xFF)
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(word ? 4 : 2, condition == 1);
+   displacement = word ? MAKE_INT_16(fetch_16()) : MAKE_INT_8(displacement);
+   target = insn_pc + 2 + displacement;
+
+   if(condition == 0)
+   {
+      /* branches to themselves burn all remaining cycles, leave that to the interpreter */
+      if(target == insn_pc)
+         return TRANSLATE_UNSUPPORTED;
+      end_instruction_branch(CYC_INSTRUCTION[insn_ir], target);
+      return TRANSLATE_END;
+   }
+
+   if(condition == 1)
+   {
+      /* push the return address, then branch relative to whatever PC the push left */
+      emit_mov_imm(ESI, insn_next_pc);
+      emit_push_32(ESI);
+      emit_alu_cpu_imm(X86_ADD, OFFSET_PC, word ? displacement - 2 : displacement);
+      end_instruction_jump(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_END;
+   }
+
+   emit_condition(condition);
+   not_taken = emit_jcc_forward(CC_Z);
+   end_instruction_branch(CYC_INSTRUCTION[insn_ir], target);
+   patch_forward(not_taken);
+   end_instruction(CYC_INSTRUCTION[insn_ir] + (sint)(word ? CYC_BCC_NOTAKE_W : CYC_BCC_NOTAKE_B));
+   return TRANSLATE_CONTINUE;
+}
+
+/* DBcc */
+static int translate_dbcc(void)
+{
+   uint condition = (insn_ir >> 8) & 0xF;
+   uint reg = insn_ir & 7;
+   uint target;
+   uint8* condition_true = NULL;
+   uint8* expired;
+   uint8* done = NULL;
+
+   begin_instruction(4, 0);
+   target = insn_pc + 2 + MAKE_INT_16(fetch_16());
+
+   if(condition == 0)
+   {
+      /* DBT never loops */
+      end_instruction(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_CONTINUE;
+   }
+
+   if(condition != 1)
+   {
+      emit_condition(condition);
+      condition_true = emit_jcc_forward(CC_NZ);
+   }
+
+   /* sub word [Dn], 1, the counter expires when it borrows */
+   emit_byte(0x66);
+   emit_byte(0x83);
+   emit_modrm_cpu(X86_SUB, OFFSET_D(reg));
+   emit_byte(1);
+   expired = emit_jcc_forward(CC_B);
+   end_instruction_branch(CYC_INSTRUCTION[insn_ir] + (sint)CYC_DBCC_F_NOEXP, target);
+
+   patch_forward(expired);
+   if(condition_true)
+   {
+      end_instruction(CYC_INSTRUCTION[insn_ir] + (sint)CYC_DBCC_F_EXP);
+      done = emit_jmp_forward();
+      patch_forward(condition_true);
+      end_instruction(CYC_INSTRUCTION[insn_ir]);
+      patch_forward(done);
+   }
+   else
+   {
+      end_instruction(CYC_INSTRUCTION[insn_ir] + (sint)CYC_DBCC_F_EXP);
+   }
+   return TRANSLATE_CONTINUE;
+}
+
+/* JMP, JSR */
+static int translate_jump(int subroutine)
+{
+   uint mode = (insn_ir >> 3) & 7;
+   uint reg = insn_ir & 7;
+   uint8* moved;
+
+   if(!ea_is_supported(mode, reg))
+      return TRANSLATE_UNSUPPORTED;
+
+   begin_instruction(2 + ea_extension_size(mode, reg, 4), subroutine);
+   emit_ea_address(mode, reg, 4);
+   if(subroutine)
+   {
+      emit_mov(R12D, EDI);
+      emit_mov_imm(ESI, insn_next_pc);
+      emit_push_32(ESI);
+      emit_store(OFFSET_PC, R12D, 4);
+   }
+   else
+   {
+      /* jumps to themselves burn all remaining cycles, leave that to the interpreter */
+      emit_alu_imm(X86_CMP, 4, EDI, insn_pc);
+      moved = emit_jcc_forward(CC_NZ);
+      emit_store_imm(OFFSET_PC, insn_pc);
+      emit_jmp_to(m68ki_translate_exit);
+      patch_forward(moved);
+      emit_store(OFFSET_PC, EDI, 4);
+   }
+   end_instruction_jump(CYC_INSTRUCTION[insn_ir]);
+   return TRANSLATE_END;
+}
+
+/* RTS, LINK, UNLK, NOP */
+static int translate_misc(void)
+{
+   uint reg = insn_ir & 7;
+
+   if(insn_ir == 0x4E71)
+   {
+      /* NOP */
+      begin_instruction(2, 0);
+      end_instruction(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_CONTINUE;
+   }
+
+   if(insn_ir == 0x4E75)
+   {
+      /* RTS */
+      begin_instruction(2, 1);
+      emit_alu_cpu_imm(X86_ADD, OFFSET_A(7), 4);
+      emit_load(EDI, OFFSET_A(7));
+      emit_alu_imm(X86_SUB, 4, EDI, 4);
+      emit_read(4);
+      emit_store(OFFSET_PC, EAX, 4);
+      end_instruction_jump(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_END;
+   }
+
+   if((insn_ir & 0xFFF8) == 0x4E50)
+   {
+      /* LINK */
+      uint displacement;
+
+      begin_instruction(4, 1);
+      displacement = MAKE_INT_16(fetch_16());
+      emit_load(ESI, OFFSET_A(reg));
+      emit_push_32(ESI);
+      emit_load(EAX, OFFSET_A(7));
+      emit_store(OFFSET_A(reg), EAX, 4);
+      emit_alu_cpu_imm(X86_ADD, OFFSET_A(7), displacement);
+      end_instruction(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_CONTINUE;
+   }
+
+   if((insn_ir & 0xFFF8) == 0x4E58)
+   {
+      /* UNLK */
+      begin_instruction(2, 1);
+      emit_load(EDI, OFFSET_A(reg));
+      emit_alu_imm(X86_ADD, 4, EDI, 4);
+      emit_store(OFFSET_A(7), EDI, 4);
+      emit_alu_imm(X86_SUB, 4, EDI, 4);
+      emit_read(4);
+      emit_store(OFFSET_A(reg), EAX, 4);
+      end_instruction(CYC_INSTRUCTION[insn_ir]);
+      return TRANSLATE_CONTINUE;
+   }
+
+   return TRANSLATE_UNSUPPORTED;
+}
+
+static int translate_instruction(void)
+{
+   insn_pc = fetch_pc;
+   insn_ir = fetch_16();
+
+   if(m68ki_instruction_jump_table[insn_ir] == m68k_op_illegal)
+      return TRANSLATE_UNSUPPORTED;
+
+   switch(insn_ir >> 12)
+   {
+      case 0x0:
+         if((insn_ir & 0xFFC0) == 0x0800)
+            return translate_btst();
+         if(!(insn_ir & 0x0100) && (insn_ir & 0x00C0) != 0x00C0)
+            return translate_immediate_op();
+         break;
+      case 0x1:
+      case 0x2:
+      case 0x3:
+         return translate_move();
+      case 0x4:
+         if((insn_ir & 0xFFF0) == 0x4E70 || (insn_ir & 0xFFF0) == 0x4E50)
+            return translate_misc();
+         if((insn_ir & 0xFF80) == 0x4E80)
+            return translate_jump(!(insn_ir & 0x0040));
+         if((insn_ir & 0xFFB8) == 0x4880 || (insn_ir & 0xFFF8) == 0x4840)
+            return translate_swap_ext();
+         if((insn_ir & 0xFB80) == 0x4880)
+            return translate_movem();
+         if((insn_ir & 0xFFC0) == 0x4840)
+            return translate_effective_address(1);
+         if((insn_ir & 0xF1C0) == 0x41C0)
+            return translate_effective_address(0);
+         if((insn_ir & 0xF900) == 0x4000 && (insn_ir & 0x00C0) != 0x00C0)
+            return translate_unary();
+         if((insn_ir & 0xFF00) == 0x4A00 && (insn_ir & 0x00C0) != 0x00C0)
+            return translate_unary();
+         break;
+      case 0x5:
+         if((insn_ir & 0xF0F8) == 0x50C8)
+            return translate_dbcc();
+         if((insn_ir & 0x00C0) != 0x00C0)
+            return translate_quick_op();
+         break;
+      case 0x6:
+         return translate_branch();
+      case 0x7:
+         if(!(insn_ir & 0x0100))
+            return translate_moveq();
+         break;
+      case 0x8:
+         if((insn_ir & 0x00C0) != 0x00C0)
+            return translate_data_op(X86_OR);
+         break;
+      case 0x9:
+         if((insn_ir & 0x00C0) == 0x00C0)
+            return translate_address_op(X86_SUB);
+         return translate_data_op(X86_SUB);
+      case 0xB:
+         if((insn_ir & 0x00C0) == 0x00C0)
+            return translate_address_op(X86_CMP);
+         return translate_data_op((insn_ir & 0x0100) ? X86_XOR : X86_CMP);
+      case 0xC:
+         if((insn_ir & 0x00C0) != 0x00C0)
+            return translate_data_op(X86_AND);
+         break;
+      case 0xD:
+         if((insn_ir & 0x00C0) == 0x00C0)
+            return translate_address_op(X86_ADD);
+         return translate_data_op(X86_ADD);
+      case 0xE:
+         if((insn_ir & 0x00C0) != 0x00C0)
+            return translate_shift();
+         break;
+   }
+
+   return TRANSLATE_UNSUPPORTED;
+}
+
+
+/* ======================================================================== */
+/* ================================ BLOCKS ================================ */
+/* ======================================================================== */
+
+static void kill_blocks(void)
+{
+   uint index;
+
+   for(index = 0; index < M68K_TRANSLATE_CACHE_SIZE; index++)
+   {
+      m68ki_translate_cache[index].pc = 0xFFFFFFFF;
+      m68ki_translate_cache[index].generation = &m68ki_translate_dead_generation;
+      m68ki_translate_cache[index].generation_snapshot = 1;
+   }
+}
+
+static int fits_in_rel32(intptr_t value)
+{
+   return value >= -0x7FFFFFFF && value <= 0x7FFFFFFF;
+}
+
+/* Get executable memory and build the block entry and exit, returns false if the host wont allow it */
+static int init_translator(void)
+{
+   intptr_t cpu = (intptr_t)&m68ki_cpu;
+
+   if(m68ki_translate_initialized)
+      return m68ki_translate_initialized == 1;
+   m68ki_translate_initialized = 2;
+
+   if(!fits_in_rel32((intptr_t)&m68ki_remaining_cycles - cpu) || !fits_in_rel32((intptr_t)&m68ki_translate_abort - cpu))
+      return 0;
+   offset_cycles = (int)((intptr_t)&m68ki_remaining_cycles - cpu);
+   offset_abort = (int)((intptr_t)&m68ki_translate_abort - cpu);
+
+#if defined(_WIN32)
+   m68ki_translate_buffer = VirtualAlloc(NULL, M68K_TRANSLATE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+   m68ki_translate_buffer = mmap(NULL, M68K_TRANSLATE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if(m68ki_translate_buffer == MAP_FAILED)
+      m68ki_translate_buffer = NULL;
+#endif
+   if(!m68ki_translate_buffer)
+      return 0;
+   m68ki_translate_buffer_end = m68ki_translate_buffer + M68K_TRANSLATE_BUFFER_SIZE;
+
+   out = m68ki_translate_buffer;
+
+   /* void enter(uint8* code): push rbx; push r12; sub rsp, 8; mov rbx, &m68ki_cpu; jmp rdi */
+   m68ki_translate_enter = (void (*)(uint8*))out;
+   emit_byte(0x53);
+   emit_byte(0x41);
+   emit_byte(0x54);
+   emit_byte(0x48);
+   emit_byte(0x83);
+   emit_byte(0xEC);
+   emit_byte(0x08);
+   emit_byte(0x48);
+   emit_byte(0xBB);
+   emit_qword((uintptr_t)cpu);
+   emit_byte(0xFF);
+   emit_byte(0xE7);
+
+   /* exit: add rsp, 8; pop r12; pop rbx; ret */
+   m68ki_translate_exit = out;
+   emit_byte(0x48);
+   emit_byte(0x83);
+   emit_byte(0xC4);
+   emit_byte(0x08);
+   emit_byte(0x41);
+   emit_byte(0x5C);
+   emit_byte(0x5B);
+   emit_byte(0xC3);
+
+   m68ki_translate_buffer = out;
+   kill_blocks();
+   m68ki_translate_initialized = 1;
+   return 1;
+}
+
+/* Returns the host code for the block at pc, or NULL if its first instruction cant be translated */
+static uint8* translate_block(uint pc, uint32* generation)
+{
+   uint count;
+
+   block_code = out;
+   block_pc = pc;
+   block_generation = generation;
+   block_generation_snapshot = *generation;
+   block_page_end = (pc & ~(M68K_CODE_GENERATION_SIZE - 1)) + M68K_CODE_GENERATION_SIZE;
+   fetch_pc = pc;
+
+   for(count = 0; ; count++)
+   {
+      uint8* insn_code = out;
+      uint start_pc = fetch_pc;
+      int result;
+
+      if(count == M68K_TRANSLATE_MAX_INSTRUCTIONS || start_pc >= block_page_end)
+      {
+         emit_store_imm(OFFSET_PC, start_pc);
+         emit_jmp_to(m68ki_translate_exit);
+         break;
+      }
+
+      fetch_overrun = 0;
+      result = translate_instruction();
+      if(fetch_overrun)
+         result = TRANSLATE_UNSUPPORTED;
+
+      if(result == TRANSLATE_UNSUPPORTED)
+      {
+         out = insn_code;
+         if(count == 0)
+            return NULL;
+         emit_store_imm(OFFSET_PC, start_pc);
+         emit_jmp_to(m68ki_translate_exit);
+         break;
+      }
+
+      if(result == TRANSLATE_END)
+         break;
+   }
+
+   return block_code;
+}
+
+/* Blocks dont call the PC changed callback, catch up before the interpreter fetches anything */
+static void sync_pc_base(void)
+{
+#if M68K_MONITOR_PC
+   if(m68ki_translate_pc_base_stale)
+   {
+      m68ki_pc_changed(REG_PC);
+      m68ki_translate_pc_base_stale = 0;
+   }
+#endif /* M68K_MONITOR_PC */
+}
+
+
+/* ======================================================================== */
+/* ================================== API ================================= */
+/* ======================================================================== */
+
+/* Run the block at PC, returns 0 if the interpreter has to run the next instruction */
+int m68ki_translate_run(void)
+{
+   m68ki_translation_t* entry = &m68ki_translate_cache[(REG_PC >> 1) & (M68K_TRANSLATE_CACHE_SIZE - 1)];
+   uint start_pc;
+   sint start_cycles;
+
+   if(m68ki_translate_initialized != 1 && !init_translator())
+      return 0;
+
+   if(entry->pc != REG_PC || *entry->generation != entry->generation_snapshot)
+   {
+      uint32* generation;
+
+      if(REG_PC & 1)
+      {
+         sync_pc_base();
+         return 0;
+      }
+
+      generation = M68K_GET_CODE_GENERATION(REG_PC);
+      if(!generation)
+      {
+         sync_pc_base();
+         return 0;
+      }
+
+      if(m68ki_translate_reset_pending || out > m68ki_translate_buffer_end - M68K_TRANSLATE_BLOCK_MARGIN)
+      {
+         kill_blocks();
+         out = m68ki_translate_buffer;
+         m68ki_translate_reset_pending = 0;
+      }
+
+      /* odd generations mean the host is watching the memory for writes */
+      if(!(*generation & 1))
+         (*generation)++;
+
+      sync_pc_base();
+      entry->pc = REG_PC;
+      entry->generation = generation;
+      entry->generation_snapshot = *generation;
+      entry->code = translate_block(REG_PC, generation);
+   }
+
+   if(!entry->code)
+   {
+      sync_pc_base();
+      return 0;
+   }
+
+   start_pc = REG_PC;
+   start_cycles = m68ki_remaining_cycles;
+   m68ki_translate_abort = 0;
+   m68ki_translate_enter(entry->code);
+   m68ki_translate_pc_base_stale = 1;
+
+   /* the block bailed out on its first instruction(a jump to itself), let the interpreter have it */
+   if(REG_PC == start_pc && m68ki_remaining_cycles == start_cycles)
+   {
+      sync_pc_base();
+      return 0;
+   }
+   return 1;
+}
+
+/* Forget all blocks, safe to call from a memory handler while a block is running */
+void m68ki_translate_flush(void)
+{
+   kill_blocks();
+   m68ki_translate_abort = 1;
+   m68ki_translate_reset_pending = 1;
+}
+
+#endif /* M68K_TRANSLATE */
+
+/* ======================================================================== */
+/* ============================== END OF FILE ============================= */
+/* ======================================================================== */
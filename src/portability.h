@@ -9,9 +9,33 @@
 #define PRAGMA_STRINGIFY(x) _Pragma(#x)
 #define MULTITHREAD_LOOP(x) PRAGMA_STRINGIFY(omp parallel for private(x))
 #define MULTITHREAD_DOUBLE_LOOP(x, y) PRAGMA_STRINGIFY(omp parallel for collapse(2) private(x, y))
+#define MULTITHREAD_SECTIONS PRAGMA_STRINGIFY(omp parallel sections)
+#define MULTITHREAD_SECTION PRAGMA_STRINGIFY(omp section)
 #else
 #define MULTITHREAD_LOOP(x)
 #define MULTITHREAD_DOUBLE_LOOP(x, y)
+#define MULTITHREAD_SECTIONS
+#define MULTITHREAD_SECTION
+#endif
+
+//atomics, only needed when a frontend reads from the emulator on another thread
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define ATOMIC_LOAD_32(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+#define ATOMIC_EXCHANGE_32(pointer, value) __atomic_exchange_n(pointer, value, __ATOMIC_ACQ_REL)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define ATOMIC_LOAD_32(pointer) ((uint32_t)_InterlockedOr((volatile long*)(pointer), 0))
+#define ATOMIC_EXCHANGE_32(pointer, value) ((uint32_t)_InterlockedExchange((volatile long*)(pointer), (long)(value)))
+#else
+//no atomics on this compiler, everything must be accessed from the emulator thread
+#define ATOMIC_LOAD_32(pointer) (*(pointer))
+static inline uint32_t atomicExchange32(uint32_t* pointer, uint32_t value){
+   uint32_t oldValue = *pointer;
+
+   *pointer = value;
+   return oldValue;
+}
+#define ATOMIC_EXCHANGE_32(pointer, value) atomicExchange32(pointer, value)
 #endif
 
 //pipeline
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "emulator.h"
@@ -60,12 +61,126 @@ static uint16_t sdCardCrc16(uint8_t* data, uint16_t size){
 
 #include "sdCardAccessors.c.h"
 
+static uint8_t* sdCardGetOverlayChunk(uint32_t chunk){
+   //copy on write, a chunk starts out as a copy of the base image
+   if(!palmSdCard.flashChipOverlay[chunk]){
+      uint32_t chunkAddress = chunk * SD_CARD_OVERLAY_CHUNK_SIZE;
+      uint32_t baseSize = FAST_MIN(palmSdCard.flashChipSize - chunkAddress, SD_CARD_OVERLAY_CHUNK_SIZE);
+      uint8_t* newChunk = malloc(SD_CARD_OVERLAY_CHUNK_SIZE);
+
+      if(!newChunk)
+         return NULL;
+
+      memcpy(newChunk, palmSdCard.flashChipData + chunkAddress, baseSize);
+      memset(newChunk + baseSize, 0x00, SD_CARD_OVERLAY_CHUNK_SIZE - baseSize);
+      palmSdCard.flashChipOverlay[chunk] = newChunk;
+   }
+
+   return palmSdCard.flashChipOverlay[chunk];
+}
+
+void sdCardReadFlash(uint8_t* data, uint32_t address, uint32_t size){
+   //anything past the end of the chip reads as 0s, the image may be a mapped file that cant be read past its end
+   while(size > 0){
+      uint32_t chunk = address / SD_CARD_OVERLAY_CHUNK_SIZE;
+      uint32_t length = FAST_MIN(size, SD_CARD_OVERLAY_CHUNK_SIZE - address % SD_CARD_OVERLAY_CHUNK_SIZE);
+
+      if(address >= palmSdCard.flashChipSize){
+         memset(data, 0x00, size);
+         return;
+      }
+
+      if(palmSdCard.flashChipOverlay && palmSdCard.flashChipOverlay[chunk]){
+         memcpy(data, palmSdCard.flashChipOverlay[chunk] + address % SD_CARD_OVERLAY_CHUNK_SIZE, length);
+      }
+      else{
+         length = FAST_MIN(length, palmSdCard.flashChipSize - address);
+         memcpy(data, palmSdCard.flashChipData + address, length);
+      }
+
+      data += length;
+      address += length;
+      size -= length;
+   }
+}
+
+bool sdCardReserveFlash(uint32_t address, uint8_t* data, uint32_t size){
+   //a chunk left reserved after a failure is a copy of the base image and reads the same as no chunk
+   if(!palmSdCard.flashChipOverlay || address >= palmSdCard.flashChipSize)
+      return true;
+   size = FAST_MIN(size, palmSdCard.flashChipSize - address);
+
+   while(size > 0){
+      uint32_t chunk = address / SD_CARD_OVERLAY_CHUNK_SIZE;
+      uint32_t length = FAST_MIN(size, SD_CARD_OVERLAY_CHUNK_SIZE - address % SD_CARD_OVERLAY_CHUNK_SIZE);
+
+      if(!palmSdCard.flashChipOverlay[chunk] && memcmp(palmSdCard.flashChipData + address, data, length) != 0 && !sdCardGetOverlayChunk(chunk))
+         return false;
+
+      data += length;
+      address += length;
+      size -= length;
+   }
+
+   return true;
+}
+
+bool sdCardWriteFlash(uint32_t address, uint8_t* data, uint32_t size){
+   //anything past the end of the chip is dropped
+   uint32_t block;
+
+   if(address >= palmSdCard.flashChipSize)
+      return true;
+   size = FAST_MIN(size, palmSdCard.flashChipSize - address);
+
+   //an unaligned write touches 1 more block
+   for(block = address / SD_CARD_BLOCK_SIZE; block <= (address + size - 1) / SD_CARD_BLOCK_SIZE; block++)
+      palmSdCard.flashChipDirtyBlocks[block / 8] |= 1 << block % 8;
+
+   if(palmSdCard.flashChipOverlay){
+      while(size > 0){
+         uint32_t chunk = address / SD_CARD_OVERLAY_CHUNK_SIZE;
+         uint32_t length = FAST_MIN(size, SD_CARD_OVERLAY_CHUNK_SIZE - address % SD_CARD_OVERLAY_CHUNK_SIZE);
+
+         //writing what the base image already has doesnt need a chunk, keeps loading states from filling the overlay
+         if(palmSdCard.flashChipOverlay[chunk] || memcmp(palmSdCard.flashChipData + address, data, length) != 0){
+            uint8_t* chunkData = sdCardGetOverlayChunk(chunk);
+
+            if(!chunkData)
+               return false;
+
+            memcpy(chunkData + address % SD_CARD_OVERLAY_CHUNK_SIZE, data, length);
+         }
+
+         data += length;
+         address += length;
+         size -= length;
+      }
+   }
+   else{
+      memcpy(palmSdCard.flashChipData + address, data, size);
+   }
+
+   return true;
+}
+
+static const uint8_t* sdCardGetReadBlock(uint32_t address){
+   //addresses dont have to be block aligned so the last block can hang off the end of the chip
+   static uint8_t readBlock[SD_CARD_BLOCK_SIZE];
+
+   if(likely(palmSdCard.flashChipSize - address >= SD_CARD_BLOCK_SIZE && (!palmSdCard.flashChipOverlay || (!palmSdCard.flashChipOverlay[address / SD_CARD_OVERLAY_CHUNK_SIZE] && !palmSdCard.flashChipOverlay[(address + SD_CARD_BLOCK_SIZE - 1) / SD_CARD_OVERLAY_CHUNK_SIZE]))))
+      return palmSdCard.flashChipData + address;
+
+   sdCardReadFlash(readBlock, address, SD_CARD_BLOCK_SIZE);
+   return readBlock;
+}
+
 static void sdCardTopOffReadBuffer(void){
    //only call during a multi block read / palmSdCard.runningCommand == READ_MULTIPLE_BLOCK
    if(unlikely(sdCardResponseFifoByteEntrys() < SD_CARD_BLOCK_SIZE)){
       sdCardDoResponseDelay(1);
       if(likely(palmSdCard.runningCommandVars[0] < palmSdCard.flashChipSize)){
-         sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, palmSdCard.flashChipData + palmSdCard.runningCommandVars[0], SD_CARD_BLOCK_SIZE);
+         sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, sdCardGetReadBlock(palmSdCard.runningCommandVars[0]), SD_CARD_BLOCK_SIZE);
          palmSdCard.runningCommandVars[0] += SD_CARD_BLOCK_SIZE;
       }
       else{
@@ -75,6 +190,40 @@ static void sdCardTopOffReadBuffer(void){
    }
 }
 
+static bool sdCardIsDataToken(uint8_t last8Bits){
+   //only call while waiting for a block during WRITE_SINGLE_BLOCK or WRITE_MULTIPLE_BLOCK
+   if(palmSdCard.runningCommand == WRITE_SINGLE_BLOCK)
+      return last8Bits == DATA_TOKEN_DEFAULT;
+   return last8Bits == DATA_TOKEN_CMD25 || last8Bits == STOP_TRAN;
+}
+
+static void sdCardCheckDataToken(void){
+   //palmSdCard.runningCommandVars[1] has the last 8 received bits
+   if(palmSdCard.runningCommand == WRITE_SINGLE_BLOCK){
+      //writing 1 block
+      if(palmSdCard.runningCommandVars[1] == DATA_TOKEN_DEFAULT){
+         //accept block
+         palmSdCard.runningCommandPacket[0] = DATA_TOKEN_DEFAULT;
+         palmSdCard.runningCommandVars[2] = 8;
+      }
+   }
+   else{
+      //writing an undefined number of blocks
+      if(unlikely(palmSdCard.runningCommandVars[1] == DATA_TOKEN_CMD25)){
+         //accept block
+         palmSdCard.runningCommandPacket[0] = DATA_TOKEN_CMD25;
+         palmSdCard.runningCommandVars[2] = 8;
+      }
+      else if(unlikely(palmSdCard.runningCommandVars[1] == STOP_TRAN)){
+         //end multiblock transfer
+         sdCardDoResponseDelay(1);
+         sdCardDoResponseBusy(1);
+         palmSdCard.runningCommand = 0x00;
+         sdCardCmdStart();
+      }
+   }
+}
+
 void sdCardReset(void){
    if(palmSdCard.flashChipData){
       palmSdCard.command = UINT64_C(0x0000000000000000);
@@ -277,7 +426,7 @@ bool sdCardExchangeBit(bool bit){
                            sdCardDoResponseR1(palmSdCard.inIdleState);
                            sdCardDoResponseDelay(1);
                            if(likely(argument < palmSdCard.flashChipSize))
-                              sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, palmSdCard.flashChipData + argument, SD_CARD_BLOCK_SIZE);
+                              sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, sdCardGetReadBlock(argument), SD_CARD_BLOCK_SIZE);
                            else
                               sdCardDoResponseErrorToken(ET_OUT_OF_RANGE);
                            break;
@@ -288,7 +437,7 @@ bool sdCardExchangeBit(bool bit){
                            if(likely(argument < palmSdCard.flashChipSize)){
                               palmSdCard.runningCommand = READ_MULTIPLE_BLOCK;
                               palmSdCard.runningCommandVars[0] = argument;
-                              sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, palmSdCard.flashChipData + palmSdCard.runningCommandVars[0], SD_CARD_BLOCK_SIZE);
+                              sdCardDoResponseDataPacket(DATA_TOKEN_DEFAULT, sdCardGetReadBlock(palmSdCard.runningCommandVars[0]), SD_CARD_BLOCK_SIZE);
                               palmSdCard.runningCommandVars[0] += SD_CARD_BLOCK_SIZE;
                            }
                            else{
@@ -376,8 +525,10 @@ bool sdCardExchangeBit(bool bit){
                   if(likely(palmSdCard.allowInvalidCrc) || sdCardCrc16(palmSdCard.runningCommandPacket + 1, SD_CARD_BLOCK_SIZE) == (palmSdCard.runningCommandPacket[SD_CARD_BLOCK_DATA_PACKET_SIZE - 2] << 8 | palmSdCard.runningCommandPacket[SD_CARD_BLOCK_DATA_PACKET_SIZE - 1])){
                      //TODO: also need to check if block is write protected, not just the card as a whole
                      if(likely(palmSdCard.runningCommandVars[0] < palmSdCard.flashChipSize && !palmSdCard.sdInfo.writeProtectSwitch)){
-                        memcpy(palmSdCard.flashChipData + palmSdCard.runningCommandVars[0], palmSdCard.runningCommandPacket + 1, SD_CARD_BLOCK_SIZE);
-                        sdCardDoResponseDataResponse(DR_ACCEPTED);
+                        if(likely(sdCardWriteFlash(palmSdCard.runningCommandVars[0], palmSdCard.runningCommandPacket + 1, SD_CARD_BLOCK_SIZE)))
+                           sdCardDoResponseDataResponse(DR_ACCEPTED);
+                        else
+                           sdCardDoResponseDataResponse(DR_WRITE_ERROR);
                      }
                      else{
                         sdCardDoResponseDataResponse(DR_WRITE_ERROR);
@@ -416,30 +567,7 @@ bool sdCardExchangeBit(bool bit){
                   palmSdCard.runningCommandVars[1] <<= 1;
                   palmSdCard.runningCommandVars[1] |= bit;
                   palmSdCard.runningCommandVars[1] &= 0xFF;
-
-                  if(palmSdCard.runningCommand == WRITE_SINGLE_BLOCK){
-                     //writing 1 block
-                     if(palmSdCard.runningCommandVars[1] == DATA_TOKEN_DEFAULT){
-                        //accept block
-                        palmSdCard.runningCommandPacket[0] = DATA_TOKEN_DEFAULT;
-                        palmSdCard.runningCommandVars[2] = 8;
-                     }
-                  }
-                  else{
-                     //writing an undefined number of blocks
-                     if(unlikely(palmSdCard.runningCommandVars[1] == DATA_TOKEN_CMD25)){
-                        //accept block
-                        palmSdCard.runningCommandPacket[0] = DATA_TOKEN_CMD25;
-                        palmSdCard.runningCommandVars[2] = 8;
-                     }
-                     else if(unlikely(palmSdCard.runningCommandVars[1] == STOP_TRAN)){
-                        //end multiblock transfer
-                        sdCardDoResponseDelay(1);
-                        sdCardDoResponseBusy(1);
-                        palmSdCard.runningCommand = 0x00;
-                        sdCardCmdStart();
-                     }
-                  }
+                  sdCardCheckDataToken();
                }
                break;
 
@@ -467,97 +595,142 @@ static uint32_t sdCardExchangeXBitsUnoptimized(uint32_t bits, uint8_t size){
    return returnBits;
 }
 
-uint32_t sdCardExchangeXBitsOptimized(uint32_t bits, uint8_t size){
-   //does the same as the above function but skips any unneeded behavior for speed
+static uint32_t sdCardExchangeXBitsConnected(uint32_t bits, uint8_t size){
+   //does the same as the above function but skips any unneeded behavior for speed, only call when the card is plugged in and chip select is low
    uint32_t returnBits = 0x00000000;
    uint32_t all1s = fillBottomWith1s(0, size);
+   bool ignoreCmdBits;
+   bool safeToOptimize;
 
    //clear unused bits that are passed
    bits &= all1s;
 
-   //make sure SD is actually plugged in and chip select is low
-   if(likely(palmSdCard.flashChipData && !palmSdCard.chipSelect)){
-      bool ignoreCmdBits = palmSdCard.commandBitsRemaining == 48 && (bits == all1s || bits == 0x00000000 && !(size & 0x1));
-      bool safeToOptimize = !palmSdCard.receivingCommand || ignoreCmdBits || palmSdCard.commandBitsRemaining > 47 && palmSdCard.commandBitsRemaining - size < 1;
-
-      if(safeToOptimize){
-         //check for simple cases
-         if(!palmSdCard.runningCommand || palmSdCard.runningCommand == READ_MULTIPLE_BLOCK){
-            //nothing will happen until this transfer is over, do fast transfer and check if FIFO needs to be refilled
-
-            if(!ignoreCmdBits){
-               palmSdCard.command <<= size;
-               palmSdCard.command |= bits;
-               palmSdCard.commandBitsRemaining -= size;
-            }
+   ignoreCmdBits = palmSdCard.commandBitsRemaining == 48 && (bits == all1s || bits == 0x00000000 && !(size & 0x1));
+   safeToOptimize = !palmSdCard.receivingCommand || ignoreCmdBits || palmSdCard.commandBitsRemaining > 47 && palmSdCard.commandBitsRemaining - size < 1;
 
-            //fill return FIFO if its getting low
-            if(palmSdCard.runningCommand == READ_MULTIPLE_BLOCK)
-               sdCardTopOffReadBuffer();
-
-            switch(size){
-               case 32:
-                  returnBits |= sdCardResponseFifoReadByteOptimized() << 24;
-               case 24:
-                  returnBits |= sdCardResponseFifoReadByteOptimized() << 16;
-               case 16:
-                  returnBits |= sdCardResponseFifoReadByteOptimized() << 8;
-               case 8:
-                  returnBits |= sdCardResponseFifoReadByteOptimized();
-                  break;
+   if(safeToOptimize){
+      //check for simple cases
+      if(!palmSdCard.runningCommand || palmSdCard.runningCommand == READ_MULTIPLE_BLOCK){
+         //nothing will happen until this transfer is over, do fast transfer and check if FIFO needs to be refilled
+
+         if(!ignoreCmdBits){
+            palmSdCard.command <<= size;
+            palmSdCard.command |= bits;
+            palmSdCard.commandBitsRemaining -= size;
+         }
 
-               default:{
-                     //slow method
-                     uint8_t index;
+         //fill return FIFO if its getting low
+         if(palmSdCard.runningCommand == READ_MULTIPLE_BLOCK)
+            sdCardTopOffReadBuffer();
+
+         switch(size){
+            case 32:
+               returnBits |= sdCardResponseFifoReadByteOptimized() << 24;
+            case 24:
+               returnBits |= sdCardResponseFifoReadByteOptimized() << 16;
+            case 16:
+               returnBits |= sdCardResponseFifoReadByteOptimized() << 8;
+            case 8:
+               returnBits |= sdCardResponseFifoReadByteOptimized();
+               break;
 
-                     for(index = 0; index < size; index++){
-                        returnBits <<= 1;
-                        returnBits |= sdCardResponseFifoReadBit();
-                     }
-                     break;
+            default:{
+                  //slow method
+                  uint8_t index;
+
+                  for(index = 0; index < size; index++){
+                     returnBits <<= 1;
+                     returnBits |= sdCardResponseFifoReadBit();
                   }
+                  break;
+               }
+         }
+      }
+      else if(palmSdCard.runningCommand == WRITE_SINGLE_BLOCK || palmSdCard.runningCommand == WRITE_MULTIPLE_BLOCK){
+         //just passthrough write data
+         uint32_t currentByte = palmSdCard.runningCommandVars[2] / 8;
+         bool alignedProperly = size % 8 == 0 && palmSdCard.runningCommandVars[2] % 8 == 0;
+
+         if(alignedProperly && currentByte > 0 && currentByte + size / 8 <= SD_CARD_BLOCK_DATA_PACKET_SIZE){
+            //byte aligned inside a data packet(CRC included), can just copy data over, the packet is written to the chip on the bit after it ends
+            uint8_t index;
+
+            for(index = 0; index < size / 8; index++){
+               palmSdCard.runningCommandPacket[currentByte] = bits >> (size - 8) - (index * 8) & 0xFF;
+               palmSdCard.runningCommandVars[2] += 8;
+               currentByte++;
+               returnBits <<= 8;
+               returnBits |= sdCardResponseFifoReadByteOptimized();
             }
          }
-         else if(palmSdCard.runningCommand == WRITE_SINGLE_BLOCK || palmSdCard.runningCommand == WRITE_MULTIPLE_BLOCK){
-            //just passthrough write data
-            uint32_t currentByte = palmSdCard.runningCommandVars[2] / 8;
-            bool alignedProperly = size % 8 == 0 && palmSdCard.runningCommandVars[2] % 8 == 0;
-
-            if(alignedProperly && currentByte > 0 && currentByte + size / 8 < SD_CARD_BLOCK_DATA_PACKET_SIZE - 1){
-               //byte aligned in the middle of a data packet, can just copy data over
-               uint8_t index;
+         else if(size % 8 == 0 && palmSdCard.runningCommandVars[2] == 0){
+            //waiting for a data token, if it cant show up before the last bit the whole transfer can be shifted in at once
+            uint8_t last8Bits = palmSdCard.runningCommandVars[1];
+            bool tokenBeforeEnd = false;
+            uint8_t index;
+
+            for(index = 0; index < size - 1; index++){
+               last8Bits = last8Bits << 1 | ((bits >> (size - 1 - index)) & 0x01);
+               if(sdCardIsDataToken(last8Bits)){
+                  tokenBeforeEnd = true;
+                  break;
+               }
+            }
 
+            if(!tokenBeforeEnd){
                for(index = 0; index < size / 8; index++){
-                  palmSdCard.runningCommandPacket[currentByte] = bits >> (size - 8) - (index * 8) & 0xFF;
-                  palmSdCard.runningCommandVars[2] += 8;
-                  currentByte++;
                   returnBits <<= 8;
                   returnBits |= sdCardResponseFifoReadByteOptimized();
                }
+               palmSdCard.runningCommandVars[1] = bits & 0xFF;
+               sdCardCheckDataToken();
             }
             else{
-               //not write safe
                returnBits = sdCardExchangeXBitsUnoptimized(bits, size);
             }
          }
          else{
-            //unknown condition
+            //not write safe
             returnBits = sdCardExchangeXBitsUnoptimized(bits, size);
          }
       }
       else{
-         //not safe to optimize :(
+         //unknown condition
          returnBits = sdCardExchangeXBitsUnoptimized(bits, size);
       }
    }
    else{
-      //not connected, fill with 1s for the pull up resistor
-      returnBits = all1s;
+      //not safe to optimize :(
+      returnBits = sdCardExchangeXBitsUnoptimized(bits, size);
    }
 
    return returnBits;
 }
 
+uint32_t sdCardExchangeXBitsOptimized(uint32_t bits, uint8_t size){
+   //make sure SD is actually plugged in and chip select is low
+   if(likely(palmSdCard.flashChipData && !palmSdCard.chipSelect))
+      return sdCardExchangeXBitsConnected(bits, size);
+
+   //not connected, fill with 1s for the pull up resistor
+   return fillBottomWith1s(0, size);
+}
+
+void sdCardExchangeXBitsBurst(uint16_t* txWords, uint16_t* rxWords, uint8_t count, uint8_t size){
+   //exchanges a whole SPI FIFO at once, the card and chip select cant change until the CPU runs again so they are only checked once
+   uint8_t index;
+
+   if(likely(palmSdCard.flashChipData && !palmSdCard.chipSelect)){
+      for(index = 0; index < count; index++)
+         rxWords[index] = sdCardExchangeXBitsConnected(txWords[index], size);
+   }
+   else{
+      //not connected, fill with 1s for the pull up resistor
+      for(index = 0; index < count; index++)
+         rxWords[index] = fillBottomWith1s(0, size);
+   }
+}
+
 /*
 Dident know where to put this note so it went here:
 CRCs should be safe to ignore on OS 5 as the CPU has builtin MMC support which does the CRC stuff automaticly,
@@ -6,8 +6,13 @@
 
 void sdCardReset(void);
 
+void sdCardReadFlash(uint8_t* data, uint32_t address, uint32_t size);
+bool sdCardReserveFlash(uint32_t address, uint8_t* data, uint32_t size);//allocates every overlay chunk a sdCardWriteFlash() of the same data needs so that write cant fail, false = out of memory
+bool sdCardWriteFlash(uint32_t address, uint8_t* data, uint32_t size);//false = out of memory, only happens when writing to an overlay
+
 void sdCardSetChipSelect(bool value);
 bool sdCardExchangeBit(bool bit);
 uint32_t sdCardExchangeXBitsOptimized(uint32_t bits, uint8_t size);
+void sdCardExchangeXBitsBurst(uint16_t* txWords, uint16_t* rxWords, uint8_t count, uint8_t size);//size is in bits and cant be more than 16
 
 #endif
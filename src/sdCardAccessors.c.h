@@ -65,6 +65,17 @@ static void sdCardResponseFifoWriteByte(uint8_t value){
    }
 }
 
+static void sdCardResponseFifoWriteBytes(const uint8_t* data, uint16_t size){
+   //same as sdCardResponseFifoWriteByte() on each byte, whatever doesnt fit is dropped
+   uint16_t firstPart;
+
+   size = FAST_MIN(size, SD_CARD_RESPONSE_FIFO_SIZE - 1 - sdCardResponseFifoByteEntrys());
+   firstPart = FAST_MIN(size, SD_CARD_RESPONSE_FIFO_SIZE - palmSdCard.responseWritePosition);
+   memcpy(palmSdCard.responseFifo + palmSdCard.responseWritePosition, data, firstPart);
+   memcpy(palmSdCard.responseFifo, data + firstPart, size - firstPart);
+   palmSdCard.responseWritePosition = (palmSdCard.responseWritePosition + size) % SD_CARD_RESPONSE_FIFO_SIZE;
+}
+
 static void sdCardResponseFifoFlush(void){
    palmSdCard.responseReadPosition = palmSdCard.responseWritePosition;
    palmSdCard.responseReadPositionBit = 7;
@@ -103,7 +114,6 @@ static void sdCardDoResponseR3R7(uint8_t r1, uint32_t value){
 
 static void sdCardDoResponseDataPacket(uint8_t token, const uint8_t* data, uint16_t size){
    uint16_t crc16;
-   uint16_t offset;
 
    if(likely(palmSdCard.allowInvalidCrc))
       crc16 = 0x0000;
@@ -111,8 +121,7 @@ static void sdCardDoResponseDataPacket(uint8_t token, const uint8_t* data, uint1
       crc16 = sdCardCrc16(data, size);
 
    sdCardResponseFifoWriteByte(token);
-   for(offset = 0; offset < size; offset++)
-      sdCardResponseFifoWriteByte(data[offset]);
+   sdCardResponseFifoWriteBytes(data, size);
    sdCardResponseFifoWriteByte(crc16 >> 8);
    sdCardResponseFifoWriteByte(crc16 & 0xFF);
 }
@@ -4,9 +4,16 @@
 #include "emulator.h"
 #include "portability.h"
 #include "dbvz.h"
+#include "sed1376.h"
 #include "flx68000.h"//for flx68000GetPc()
 #include "specs/sed1376RegisterSpec.h"
 
+#if defined(__SSE2__) && !defined(EMU_NO_SIMD)
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(EMU_NO_SIMD)
+#include <arm_neon.h>
+#endif
+
 
 //the SED1376 has only 16 address lines(17 if you count the line that switches between registers and framebuffer) and 16 data lines, the most you can read at once is 16 bits, registers are 8 bits
 
@@ -24,27 +31,47 @@
 
 #define SED1376_REG_SIZE 0xB4
 #define SED1376_LUT_SIZE 0x100
-#define SED1376_RAM_SIZE  0x20000//actual size is 0x14000, but that cant be masked off by address lines so size is increased to prevent buffer overflow
 
 
 uint16_t* sed1376Framebuffer;
 uint8_t   sed1376Ram[SED1376_RAM_SIZE];
+uint8_t   sed1376RamDirtyBlocks[SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8];
 
 static uint8_t  sed1376Registers[SED1376_REG_SIZE];
 static uint8_t  sed1376RLut[SED1376_LUT_SIZE];
 static uint8_t  sed1376GLut[SED1376_LUT_SIZE];
 static uint8_t  sed1376BLut[SED1376_LUT_SIZE];
 static uint16_t sed1376OutputLut[SED1376_LUT_SIZE];//used to speed up pixel conversion
+static uint16_t sed1376MonochromeLut[SED1376_LUT_SIZE];//same as sed1376OutputLut but only uses the green LUT
+static uint8_t  snapshotRegisters[SED1376_REG_SIZE];//everything the renderer reads is copied at the end of a frame so it can run while the CPU does the next one
+static uint16_t snapshotOutputLut[SED1376_LUT_SIZE];
+static uint16_t snapshotMonochromeLut[SED1376_LUT_SIZE];
+static uint8_t  snapshotRam[SED1376_RAM_SIZE];
+static uint8_t  snapshotRamDirtyBlocks[SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8];
+static bool     snapshotRegistersChanged;
+static bool     snapshotScreenOn;
+static bool     snapshotLcdOn;
+static bool     snapshotPllOn;
+static uint8_t  snapshotBacklightLevel;
 static uint32_t screenStartAddress;
 static uint16_t lineSize;
-static uint16_t (*renderPixel)(uint16_t x, uint16_t y);
+static uint16_t renderLut[SED1376_LUT_SIZE];//the current LUT with inversion and backlight already applied
+static uint8_t  renderSwaps;
+static uint16_t renderInvertMask;
+static uint8_t  renderDimShift;
+static uint16_t renderDimMask;
+static void (*renderLine)(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX);
+static bool     registersChanged;//anything that isnt VRAM changed, the whole screen needs to be redrawn
+static bool     lastScreenOn;
+static uint16_t* lastFramebuffer;//the frontend may still be reading it, only lines that didnt change are copied from it
+static uint8_t  lastBacklightLevel;
 
 
 #include "sed1376Accessors.c.h"
 
 static uint32_t getBufferStartAddress(void){
-   uint32_t screenStartAddress = sed1376Registers[DISP_ADDR_2] << 16 | sed1376Registers[DISP_ADDR_1] << 8 | sed1376Registers[DISP_ADDR_0];
-   switch((sed1376Registers[SPECIAL_EFFECT] & 0x03) * 90){
+   uint32_t screenStartAddress = snapshotRegisters[DISP_ADDR_2] << 16 | snapshotRegisters[DISP_ADDR_1] << 8 | snapshotRegisters[DISP_ADDR_0];
+   switch((snapshotRegisters[SPECIAL_EFFECT] & 0x03) * 90){
       case 0:
          //desired byte address / 4.
          screenStartAddress *= 4;
@@ -75,8 +102,8 @@ static uint32_t getBufferStartAddress(void){
 }
 
 static uint32_t getPipStartAddress(void){
-   uint32_t pipStartAddress = sed1376Registers[PIP_ADDR_2] << 16 | sed1376Registers[PIP_ADDR_1] << 8 | sed1376Registers[PIP_ADDR_0];
-   switch((sed1376Registers[SPECIAL_EFFECT] & 0x03) * 90){
+   uint32_t pipStartAddress = snapshotRegisters[PIP_ADDR_2] << 16 | snapshotRegisters[PIP_ADDR_1] << 8 | snapshotRegisters[PIP_ADDR_0];
+   switch((snapshotRegisters[SPECIAL_EFFECT] & 0x03) * 90){
       case 0:
          //desired byte address / 4.
          pipStartAddress *= 4;
@@ -109,15 +136,18 @@ static uint32_t getPipStartAddress(void){
 void sed1376Reset(void){
    memset(sed1376Registers, 0x00, SED1376_REG_SIZE);
    memset(sed1376OutputLut, 0x00, SED1376_LUT_SIZE * sizeof(uint16_t));
+   memset(sed1376MonochromeLut, 0x00, SED1376_LUT_SIZE * sizeof(uint16_t));
    memset(sed1376RLut, 0x00, SED1376_LUT_SIZE);
    memset(sed1376GLut, 0x00, SED1376_LUT_SIZE);
    memset(sed1376BLut, 0x00, SED1376_LUT_SIZE);
    memset(sed1376Ram, 0x00, SED1376_RAM_SIZE);
+   memset(sed1376RamDirtyBlocks, 0x00, SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8);
 
    palmMisc.backlightLevel = 0;
    palmMisc.lcdOn = false;
 
-   renderPixel = NULL;
+   renderLine = NULL;
+   registersChanged = true;
 
    sed1376Registers[REV_CODE] = 0x28;
    sed1376Registers[DISP_BUFF_SIZE] = 0x14;
@@ -167,8 +197,12 @@ void sed1376LoadState(uint8_t* data){
    offset += SED1376_RAM_SIZE;
 
    //refresh LUT
-   MULTITHREAD_LOOP(index) for(index = 0; index < SED1376_LUT_SIZE; index++)
+   MULTITHREAD_LOOP(index) for(index = 0; index < SED1376_LUT_SIZE; index++){
       sed1376OutputLut[index] = makeRgb16FromSed666(sed1376RLut[index], sed1376GLut[index], sed1376BLut[index]);
+      sed1376MonochromeLut[index] = makeRgb16FromSed666(sed1376GLut[index], sed1376GLut[index], sed1376GLut[index]);
+   }
+
+   registersChanged = true;
 }
 
 bool sed1376PowerSaveEnabled(void){
@@ -211,7 +245,7 @@ uint8_t sed1376GetRegister(uint8_t address){
    }
 }
 
-void sed1376SetRegister(uint8_t address, uint8_t value){
+static void setRegisterValue(uint8_t address, uint8_t value){
    switch(address){
       case PWR_SAVE_CFG:
          //bit 7 must always be set, timing hack
@@ -271,6 +305,7 @@ void sed1376SetRegister(uint8_t address, uint8_t value){
          }
          */
          sed1376OutputLut[value] = makeRgb16FromSed666(sed1376RLut[value], sed1376GLut[value], sed1376BLut[value]);
+         sed1376MonochromeLut[value] = makeRgb16FromSed666(sed1376GLut[value], sed1376GLut[value], sed1376GLut[value]);
          return;
 
       case LUT_READ_LOC:
@@ -350,35 +385,94 @@ void sed1376SetRegister(uint8_t address, uint8_t value){
    }
 }
 
-void sed1376Render(void){
+void sed1376SetRegister(uint8_t address, uint8_t value){
+   uint8_t oldValue = address < SED1376_REG_SIZE ? sed1376Registers[address] : 0x00;
+
+   setRegisterValue(address, value);
+
+   //the LUT isnt stored in the registers so any write to it counts as a change
+   if(address == LUT_WRITE_LOC || (address < SED1376_REG_SIZE && sed1376Registers[address] != oldValue))
+      registersChanged = true;
+}
+
+void sed1376Snapshot(void){
+   uint16_t index;
+
+   //a register change redraws everything so all of VRAM is taken, otherwise only the blocks written since the last snapshot
+   memcpy(snapshotRegisters, sed1376Registers, SED1376_REG_SIZE);
+   if(registersChanged){
+      memcpy(snapshotOutputLut, sed1376OutputLut, SED1376_LUT_SIZE * sizeof(uint16_t));
+      memcpy(snapshotMonochromeLut, sed1376MonochromeLut, SED1376_LUT_SIZE * sizeof(uint16_t));
+      memcpy(snapshotRam, sed1376Ram, SED1376_RAM_SIZE);
+      snapshotRegistersChanged = true;
+      registersChanged = false;
+   }
+   else{
+      for(index = 0; index < SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8; index++){
+         if(sed1376RamDirtyBlocks[index]){
+            uint8_t bit;
+
+            for(bit = 0; bit < 8; bit++){
+               if(sed1376RamDirtyBlocks[index] & 1 << bit){
+                  uint32_t address = (index * 8 + bit) * SED1376_DIRTY_BLOCK_SIZE;
+
+                  memcpy(snapshotRam + address, sed1376Ram + address, SED1376_DIRTY_BLOCK_SIZE);
+               }
+            }
+         }
+      }
+   }
+
+   //snapshots taken without a render in between add up
+   for(index = 0; index < SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8; index++)
+      snapshotRamDirtyBlocks[index] |= sed1376RamDirtyBlocks[index];
+   memset(sed1376RamDirtyBlocks, 0x00, SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8);
+
    //render if LCD on, PLL on, power save off and force blank off, SED1376 clock is provided by the CPU, if its off so is the SED
-   if(palmMisc.lcdOn && dbvzIsPllOn() && !sed1376PowerSaveEnabled() && !(sed1376Registers[DISP_MODE] & 0x80)){
-      bool color = !!(sed1376Registers[PANEL_TYPE] & 0x40);
-      bool pictureInPictureEnabled = !!(sed1376Registers[SPECIAL_EFFECT] & 0x10);
-      uint8_t bitDepth = 1 << (sed1376Registers[DISP_MODE] & 0x07);
-      uint16_t rotation = 90 * (sed1376Registers[SPECIAL_EFFECT] & 0x03);
-      uint32_t index;
-
-      screenStartAddress = getBufferStartAddress();
-      lineSize = (sed1376Registers[LINE_SIZE_1] << 8 | sed1376Registers[LINE_SIZE_0]) * 4;
+   snapshotLcdOn = palmMisc.lcdOn;
+   snapshotPllOn = dbvzIsPllOn();
+   snapshotBacklightLevel = palmMisc.backlightLevel;
+   snapshotScreenOn = snapshotLcdOn && snapshotPllOn && !sed1376PowerSaveEnabled() && !(sed1376Registers[DISP_MODE] & 0x80);
+}
+
+bool sed1376Render(void){
+   bool screenOn = snapshotScreenOn;
+   bool redrawAll = snapshotRegistersChanged || screenOn != lastScreenOn || snapshotBacklightLevel != lastBacklightLevel;
+   bool changed = false;
+
+   snapshotRegistersChanged = false;
+   lastScreenOn = screenOn;
+   lastBacklightLevel = snapshotBacklightLevel;
+
+   if(screenOn){
+      bool color = !!(snapshotRegisters[PANEL_TYPE] & 0x40);
+      bool pictureInPictureEnabled = !!(snapshotRegisters[SPECIAL_EFFECT] & 0x10);
+      uint8_t bitDepth = 1 << (snapshotRegisters[DISP_MODE] & 0x07);
+      uint16_t rotation = 90 * (snapshotRegisters[SPECIAL_EFFECT] & 0x03);
+      uint32_t mainStartAddress = getBufferStartAddress();
+      uint16_t mainLineSize = (snapshotRegisters[LINE_SIZE_1] << 8 | snapshotRegisters[LINE_SIZE_0]) * 4;
+
       selectRenderer(color, bitDepth);
 
-      if(renderPixel){
-         uint16_t pixelX;
+      if(renderLine){
+         bool lineDirty[160];
+         bool pipOnscreen = false;
+         uint32_t pipStartAddress;
+         uint16_t pipLineSize;
+         uint16_t pipStartX;
+         uint16_t pipStartY;
+         uint16_t pipEndX;
+         uint16_t pipEndY;
          uint16_t pixelY;
 
-         MULTITHREAD_DOUBLE_LOOP(pixelX, pixelY) for(pixelY = 0; pixelY < 160; pixelY++)
-            for(pixelX = 0; pixelX < 160; pixelX++)
-               sed1376Framebuffer[pixelY * 160 + pixelX] = renderPixel(pixelX, pixelY);
-
-         //debugLog("Screen start address:0x%08X, buffer width:%d, swivel view:%d degrees\n", screenStartAddress, lineSize, rotation);
+         //debugLog("Screen start address:0x%08X, buffer width:%d, swivel view:%d degrees\n", mainStartAddress, mainLineSize, rotation);
          //debugLog("Screen format, color:%s, BPP:%d\n", boolString(color), bitDepth);
 
          if(pictureInPictureEnabled){
-            uint16_t pipStartX = sed1376Registers[PIP_X_START_1] << 8 | sed1376Registers[PIP_X_START_0];
-            uint16_t pipStartY = sed1376Registers[PIP_Y_START_1] << 8 | sed1376Registers[PIP_Y_START_0];
-            uint16_t pipEndX = (sed1376Registers[PIP_X_END_1] << 8 | sed1376Registers[PIP_X_END_0]) + 1;
-            uint16_t pipEndY = (sed1376Registers[PIP_Y_END_1] << 8 | sed1376Registers[PIP_Y_END_0]) + 1;
+            pipStartX = snapshotRegisters[PIP_X_START_1] << 8 | snapshotRegisters[PIP_X_START_0];
+            pipStartY = snapshotRegisters[PIP_Y_START_1] << 8 | snapshotRegisters[PIP_Y_START_0];
+            pipEndX = (snapshotRegisters[PIP_X_END_1] << 8 | snapshotRegisters[PIP_X_END_0]) + 1;
+            pipEndY = (snapshotRegisters[PIP_Y_END_1] << 8 | snapshotRegisters[PIP_Y_END_0]) + 1;
 
             if(rotation == 0 || rotation == 180){
                pipStartX *= 32 / bitDepth;
@@ -393,49 +487,78 @@ void sed1376Render(void){
             if(pipStartX < 160 && pipStartY < 160){
                pipEndX = FAST_MIN(pipEndX, 160);
                pipEndY = FAST_MIN(pipEndY, 160);
-               screenStartAddress = getPipStartAddress();
-               lineSize = (sed1376Registers[PIP_LINE_SZ_1] << 8 | sed1376Registers[PIP_LINE_SZ_0]) * 4;
-               MULTITHREAD_DOUBLE_LOOP(pixelX, pixelY) for(pixelY = pipStartY; pixelY < pipEndY; pixelY++)
-                  for(pixelX = pipStartX; pixelX < pipEndX; pixelX++)
-                     sed1376Framebuffer[pixelY * 160 + pixelX] = renderPixel(pixelX, pixelY);
+               pipOnscreen = pipStartX < pipEndX;
+               pipStartAddress = getPipStartAddress();
+               pipLineSize = (snapshotRegisters[PIP_LINE_SZ_1] << 8 | snapshotRegisters[PIP_LINE_SZ_0]) * 4;
             }
          }
 
-         //rotation
-         //later, unemulated
+         //only lines that read VRAM written since the last render need to be drawn again
+         if(redrawAll){
+            memset(lineDirty, true, sizeof(lineDirty));
+            changed = true;
+         }
+         else{
+            screenStartAddress = mainStartAddress;
+            lineSize = mainLineSize;
+            for(pixelY = 0; pixelY < 160; pixelY++){
+               lineDirty[pixelY] = lineSourceDirty(pixelY, 0, 160, color, bitDepth);
+               changed |= lineDirty[pixelY];
+            }
+
+            if(pipOnscreen){
+               screenStartAddress = pipStartAddress;
+               lineSize = pipLineSize;
+               for(pixelY = pipStartY; pixelY < pipEndY; pixelY++){
+                  if(!lineDirty[pixelY] && lineSourceDirty(pixelY, pipStartX, pipEndX, color, bitDepth)){
+                     lineDirty[pixelY] = true;
+                     changed = true;
+                  }
+               }
+            }
+         }
 
-         //display inversion
-         if((sed1376Registers[DISP_MODE] & 0x30) == 0x10)
-            MULTITHREAD_LOOP(index) for(index = 0; index < 160 * 160; index++)
-               sed1376Framebuffer[index] = ~sed1376Framebuffer[index];
+         if(changed){
+            //sed1376Framebuffer can be a different buffer than last time, it needs the lines that arent redrawn
+            if(!redrawAll && sed1376Framebuffer != lastFramebuffer)
+               for(pixelY = 0; pixelY < 160; pixelY++)
+                  if(!lineDirty[pixelY])
+                     memcpy(sed1376Framebuffer + pixelY * 160, lastFramebuffer + pixelY * 160, 160 * sizeof(uint16_t));
+
+            screenStartAddress = mainStartAddress;
+            lineSize = mainLineSize;
+            MULTITHREAD_LOOP(pixelY) for(pixelY = 0; pixelY < 160; pixelY++)
+               if(lineDirty[pixelY])
+                  renderLine(sed1376Framebuffer + pixelY * 160, pixelY, 0, 160);
+
+            if(pipOnscreen){
+               screenStartAddress = pipStartAddress;
+               lineSize = pipLineSize;
+               MULTITHREAD_LOOP(pixelY) for(pixelY = pipStartY; pixelY < pipEndY; pixelY++)
+                  if(lineDirty[pixelY])
+                     renderLine(sed1376Framebuffer + pixelY * 160, pixelY, pipStartX, pipEndX);
+            }
 
+            //rotation
+            //later, unemulated
 
-         //backlight level, 0 = 1/4 color intensity, 1 = 1/2 color intensity, 2 = full color intensity
-         switch(palmMisc.backlightLevel){
-            case 0:
-               MULTITHREAD_LOOP(index) for(index = 0; index < 160 * 160; index++){
-                  sed1376Framebuffer[index] >>= 2;
-                  sed1376Framebuffer[index] &= 0x39E7;
-               }
-               break;
-            case 1:
-               MULTITHREAD_LOOP(index) for(index = 0; index < 160 * 160; index++){
-                  sed1376Framebuffer[index] >>= 1;
-                  sed1376Framebuffer[index] &= 0x7BEF;
-               }
-               break;
-            case 2:
-               //nothing
-               break;
+            //display inversion and backlight level are applied as each line is converted
          }
       }
       else{
          debugLog("Invalid screen format, color:%s, BPP:%d, rotation:%d\n", color ? "true" : "false", bitDepth, rotation);
       }
    }
-   else{
-      //black screen
+   else if(redrawAll){
+      //black screen, only needs to be drawn once
       memset(sed1376Framebuffer, 0x00, 160 * 160 * sizeof(uint16_t));
-      debugLog("Cant draw screen, LCD on:%s, PLL on:%s, power save on:%s, forced blank on:%s\n", palmMisc.lcdOn ? "true" : "false", dbvzIsPllOn() ? "true" : "false", sed1376PowerSaveEnabled() ? "true" : "false", !!(sed1376Registers[DISP_MODE] & 0x80) ? "true" : "false");
+      changed = true;
+      debugLog("Cant draw screen, LCD on:%s, PLL on:%s, power save on:%s, forced blank on:%s\n", snapshotLcdOn ? "true" : "false", snapshotPllOn ? "true" : "false", (snapshotRegisters[PWR_SAVE_CFG] & 0x01) ? "true" : "false", !!(snapshotRegisters[DISP_MODE] & 0x80) ? "true" : "false");
    }
+
+   memset(snapshotRamDirtyBlocks, 0x00, SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8);
+   if(changed)
+      lastFramebuffer = sed1376Framebuffer;
+
+   return changed;
 }
@@ -4,8 +4,17 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define SED1376_RAM_SIZE 0x20000//actual size is 0x14000, but that cant be masked off by address lines so size is increased to prevent buffer overflow
+#define SED1376_DIRTY_BLOCK_SIZE 16//VRAM writes are tracked in blocks of this many bytes
+
 extern uint16_t* sed1376Framebuffer;
 extern uint8_t   sed1376Ram[];
+extern uint8_t   sed1376RamDirtyBlocks[];
+
+static inline void sed1376MarkRamDirty(uint32_t address){
+   address &= SED1376_RAM_SIZE - 1;
+   sed1376RamDirtyBlocks[address / SED1376_DIRTY_BLOCK_SIZE / 8] |= 1 << address / SED1376_DIRTY_BLOCK_SIZE % 8;
+}
 
 void sed1376Reset(void);
 uint32_t sed1376StateSize(void);
@@ -16,6 +25,7 @@ bool sed1376PowerSaveEnabled(void);
 uint8_t sed1376GetRegister(uint8_t address);
 void sed1376SetRegister(uint8_t address, uint8_t value);
 
-void sed1376Render(void);
+void sed1376Snapshot(void);//copys everything sed1376Render() uses, call at the end of a frame
+bool sed1376Render(void);//draws the last snapshot, can run on another thread while the next frame is emulated//returns if sed1376Framebuffer was changed
 
 #endif
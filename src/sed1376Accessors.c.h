@@ -1,14 +1,17 @@
 //data access
-static uint32_t handlePanelDataSwaps(uint32_t address){
+static uint8_t getPanelDataSwaps(void){
+   //the swaps just change which byte of a 32 bit group is read, this returns what to XOR the address with
+   uint8_t swaps = 0x00;
+
 #if !defined(EMU_NO_SAFETY)
    //word swap
-   if(sed1376Registers[SPECIAL_EFFECT] & 0x80)
-      address ^= 0x00000002;
+   if(snapshotRegisters[SPECIAL_EFFECT] & 0x80)
+      swaps |= 0x02;
 #endif
    //byte swap, used in 16 bpp mode
-   if(sed1376Registers[SPECIAL_EFFECT] & 0x40)
-      address ^= 0x00000001;
-   return address;
+   if(snapshotRegisters[SPECIAL_EFFECT] & 0x40)
+      swaps |= 0x01;
+   return swaps;
 }
 
 //color conversion
@@ -24,94 +27,200 @@ static uint16_t makeRgb16FromGreenComponent(uint16_t g){
    color |= g << 5 & 0xF1;
    return color;
 }
-static uint16_t lutMonochromeValue(uint8_t lutIndex){
-   return makeRgb16FromSed666(sed1376GLut[lutIndex], sed1376GLut[lutIndex], sed1376GLut[lutIndex]);
-}
 
-//monochrome
-static uint16_t get1BppMonochrome(uint16_t x, uint16_t y){
-   return lutMonochromeValue(sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 8)] >> (7 - x % 8) & 0x01);
+//display inversion and backlight dimming, 0 = 1/4 color intensity, 1 = 1/2 color intensity, 2 = full color intensity
+static inline uint16_t adjustPixel(uint16_t pixel){
+   return (pixel ^ renderInvertMask) >> renderDimShift & renderDimMask;
 }
-static uint16_t get2BppMonochrome(uint16_t x, uint16_t y){
-   return lutMonochromeValue(sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 4)] >> (6 - x % 4 * 2) & 0x03);
+static void adjustPixels(uint16_t* pixels, uint16_t count){
+   uint16_t index = 0;
+
+   if(renderInvertMask == 0x0000 && renderDimShift == 0)
+      return;
+
+#if defined(__SSE2__) && !defined(EMU_NO_SIMD)
+   {
+      __m128i invertMask = _mm_set1_epi16(renderInvertMask);
+      __m128i dimMask = _mm_set1_epi16(renderDimMask);
+      __m128i dimShift = _mm_cvtsi32_si128(renderDimShift);
+
+      for(; index + 8 <= count; index += 8){
+         __m128i chunk = _mm_loadu_si128((__m128i*)(pixels + index));
+
+         chunk = _mm_and_si128(_mm_srl_epi16(_mm_xor_si128(chunk, invertMask), dimShift), dimMask);
+         _mm_storeu_si128((__m128i*)(pixels + index), chunk);
+      }
+   }
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(EMU_NO_SIMD)
+   {
+      uint16x8_t invertMask = vdupq_n_u16(renderInvertMask);
+      uint16x8_t dimMask = vdupq_n_u16(renderDimMask);
+      int16x8_t dimShift = vdupq_n_s16(-renderDimShift);//negative left shift is a right shift
+
+      for(; index + 8 <= count; index += 8){
+         uint16x8_t chunk = vld1q_u16(pixels + index);
+
+         chunk = vandq_u16(vshlq_u16(veorq_u16(chunk, invertMask), dimShift), dimMask);
+         vst1q_u16(pixels + index, chunk);
+      }
+   }
+#endif
+
+   for(; index < count; index++)
+      pixels[index] = adjustPixel(pixels[index]);
 }
-static uint16_t get4BppMonochrome(uint16_t x, uint16_t y){
-   return lutMonochromeValue(sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 2)] >> (4 - x % 2 * 4) & 0x0F);
+
+//scanlines, the packed formats share one inline body that gets a copy for each bit depth so all the shifts and masks are constants
+static inline uint16_t getPackedPixel(uint32_t lineAddress, uint16_t x, uint8_t bpp){
+   uint8_t pixelsPerByte = 8 / bpp;
+
+   return renderLut[snapshotRam[(lineAddress + x / pixelsPerByte) ^ renderSwaps] >> (8 - bpp - x % pixelsPerByte * bpp) & ((1 << bpp) - 1)];
 }
-static uint16_t get8BppMonochrome(uint16_t x, uint16_t y){
-   return lutMonochromeValue(sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x)]);
+static inline void renderPackedLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX, uint8_t bpp){
+   uint32_t lineAddress = screenStartAddress + y * lineSize;
+   uint8_t pixelsPerByte = 8 / bpp;
+   uint16_t x = startX;
+
+   //a PIP window can start or end part way through a byte
+   while(x < endX && x % pixelsPerByte != 0){
+      output[x] = getPackedPixel(lineAddress, x, bpp);
+      x++;
+   }
+
+   while(x + pixelsPerByte <= endX){
+      uint8_t pixels = snapshotRam[(lineAddress + x / pixelsPerByte) ^ renderSwaps];
+      int8_t shift;
+
+      for(shift = 8 - bpp; shift >= 0; shift -= bpp){
+         output[x] = renderLut[pixels >> shift & ((1 << bpp) - 1)];
+         x++;
+      }
+   }
+
+   while(x < endX){
+      output[x] = getPackedPixel(lineAddress, x, bpp);
+      x++;
+   }
 }
-static uint16_t get16BppMonochrome(uint16_t x, uint16_t y){
-   uint16_t pixelValue = sed1376Ram[handlePanelDataSwaps(screenStartAddress + (y * lineSize + x) * 2)] << 8 | sed1376Ram[handlePanelDataSwaps(screenStartAddress + (y * lineSize + x) * 2 + 1)];
-   return makeRgb16FromGreenComponent(pixelValue);
+static void render1BppLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
+   renderPackedLine(output, y, startX, endX, 1);
 }
-
-//color
-static uint16_t get1BppColor(uint16_t x, uint16_t y){
-   return sed1376OutputLut[sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 8)] >> (7 - x % 8) & 0x01];
+static void render2BppLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
+   renderPackedLine(output, y, startX, endX, 2);
 }
-static uint16_t get2BppColor(uint16_t x, uint16_t y){
-   return sed1376OutputLut[sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 4)] >> (6 - x % 4 * 2) & 0x03];
+static void render4BppLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
+   renderPackedLine(output, y, startX, endX, 4);
 }
-static uint16_t get4BppColor(uint16_t x, uint16_t y){
-   return sed1376OutputLut[sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x / 2)] >> (4 - x % 2 * 4) & 0x0F];
+static void render8BppLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
+   renderPackedLine(output, y, startX, endX, 8);
 }
-static uint16_t get8BppColor(uint16_t x, uint16_t y){
-   return sed1376OutputLut[sed1376Ram[handlePanelDataSwaps(screenStartAddress + y * lineSize + x)]];
+static void render16BppMonochromeLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
+   uint32_t lineAddress = screenStartAddress + y * lineSize * 2;
+   uint16_t x;
+
+   for(x = startX; x < endX; x++)
+      output[x] = makeRgb16FromGreenComponent(snapshotRam[(lineAddress + x * 2) ^ renderSwaps] << 8 | snapshotRam[(lineAddress + x * 2 + 1) ^ renderSwaps]);
+   adjustPixels(output + startX, endX - startX);
 }
-static uint16_t get16BppColor(uint16_t x, uint16_t y){
+static void render16BppColorLine(uint16_t* output, uint16_t y, uint16_t startX, uint16_t endX){
    //this format is little endian, to use big endian data sed1376Registers[SPECIAL_EFFECT] & 0x40 must be set
-   return sed1376Ram[handlePanelDataSwaps(screenStartAddress + (y * lineSize + x * 2) + 1)] << 8 | sed1376Ram[handlePanelDataSwaps(screenStartAddress + (y * lineSize + x * 2))];
+   uint32_t lineAddress = screenStartAddress + y * lineSize;
+   uint16_t x;
+
+#if !defined(EMU_BIG_ENDIAN)
+   //without swaps VRAM is already in host order
+   if(renderSwaps == 0x00)
+      memcpy(output + startX, snapshotRam + lineAddress + startX * 2, (endX - startX) * sizeof(uint16_t));
+   else
+#endif
+      for(x = startX; x < endX; x++)
+         output[x] = snapshotRam[(lineAddress + x * 2 + 1) ^ renderSwaps] << 8 | snapshotRam[(lineAddress + x * 2) ^ renderSwaps];
+   adjustPixels(output + startX, endX - startX);
 }
 
 static void selectRenderer(bool color, uint8_t bpp){
-   renderPixel = NULL;
-   if(color){
-      switch(bpp){
-         case 1:
-            renderPixel = get1BppColor;
-            break;
-
-         case 2:
-            renderPixel = get2BppColor;
-            break;
-
-         case 4:
-            renderPixel = get4BppColor;
-            break;
-
-         case 8:
-            renderPixel = get8BppColor;
-            break;
-
-         case 16:
-            renderPixel = get16BppColor;
-            break;
-      }
+   renderLine = NULL;
+   renderSwaps = getPanelDataSwaps();
+   renderInvertMask = (snapshotRegisters[DISP_MODE] & 0x30) == 0x10 ? 0xFFFF : 0x0000;
+   switch(snapshotBacklightLevel){
+      case 0:
+         renderDimShift = 2;
+         renderDimMask = 0x39E7;
+         break;
+
+      case 1:
+         renderDimShift = 1;
+         renderDimMask = 0x7BEF;
+         break;
+
+      default:
+         renderDimShift = 0;
+         renderDimMask = 0xFFFF;
+         break;
+   }
+
+   //the packed formats get inversion and dimming for free by applying them to the LUT
+   if(bpp <= 8){
+      const uint16_t* lut = color ? snapshotOutputLut : snapshotMonochromeLut;
+      uint16_t index;
+
+      for(index = 0; index < 1 << bpp; index++)
+         renderLut[index] = adjustPixel(lut[index]);
+   }
+
+   switch(bpp){
+      case 1:
+         renderLine = render1BppLine;
+         break;
+
+      case 2:
+         renderLine = render2BppLine;
+         break;
+
+      case 4:
+         renderLine = render4BppLine;
+         break;
+
+      case 8:
+         renderLine = render8BppLine;
+         break;
+
+      case 16:
+         renderLine = color ? render16BppColorLine : render16BppMonochromeLine;
+         break;
+   }
+}
+
+static bool lineSourceDirty(uint16_t y, uint16_t startX, uint16_t endX, bool color, uint8_t bpp){
+   //the VRAM a line is drawn from, rounded out to 32 bits because the swaps can move a read anywhere within its group
+   uint32_t firstByte;
+   uint32_t lastByte;
+   uint32_t block;
+
+   if(bpp == 16){
+      uint32_t lineAddress = screenStartAddress + y * lineSize * (color ? 1 : 2);
+
+      firstByte = lineAddress + startX * 2;
+      lastByte = lineAddress + (endX - 1) * 2 + 1;
    }
    else{
-      switch(bpp){
-         case 1:
-            renderPixel = get1BppMonochrome;
-            break;
-
-         case 2:
-            renderPixel = get2BppMonochrome;
-            break;
-
-         case 4:
-            renderPixel = get4BppMonochrome;
-            break;
-
-         case 8:
-            renderPixel = get8BppMonochrome;
-            break;
-
-         case 16:
-            renderPixel = get16BppMonochrome;
-            break;
-      }
+      uint32_t lineAddress = screenStartAddress + y * lineSize;
+
+      firstByte = lineAddress + startX / (8 / bpp);
+      lastByte = lineAddress + (endX - 1) / (8 / bpp);
    }
+   firstByte &= 0xFFFFFFFC;
+   lastByte |= 0x00000003;
+
+   //reads past the end of VRAM arent tracked
+   if(lastByte >= SED1376_RAM_SIZE)
+      return true;
+
+   for(block = firstByte / SED1376_DIRTY_BLOCK_SIZE; block <= lastByte / SED1376_DIRTY_BLOCK_SIZE; block++)
+      if(snapshotRamDirtyBlocks[block / 8] & 1 << block % 8)
+         return true;
+
+   return false;
 }
 
 //updaters
@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "dbvz.h"
+#include "m515Bus.h"
+#include "flx68000.h"
+#include "m68k/m68k.h"
+
+
+//runs the 32 bit ADD/SUB/CMP/NEG style instructions against random and edge operands, then reads the flags back with Scc, ADDX and MOVE from SR
+//the output hash has to match the one the plain m68k interpreter gave before the recompiler and the other CPU changes
+
+#define TEST_BLOCKS 8192
+#define CODE_START 0x00010000
+#define DATA_START 0x00200000
+#define OUTPUT_START 0x00400000
+#define STACK_START 0x00008000
+#define EXPECTED_HASH 0x2C47FED2
+
+
+typedef struct{
+   uint16_t opcode[3];
+   uint8_t  length;
+}flagOp_t;
+
+static const flagOp_t flagOps[] = {
+   {{0xD081}, 1},//ADD.L D1,D0
+   {{0x9081}, 1},//SUB.L D1,D0
+   {{0xB081}, 1},//CMP.L D1,D0
+   {{0xD181}, 1},//ADDX.L D1,D0
+   {{0x9181}, 1},//SUBX.L D1,D0
+   {{0x4480}, 1},//NEG.L D0
+   {{0x4080}, 1},//NEGX.L D0
+   {{0x5280}, 1},//ADDQ.L #1,D0
+   {{0x5380}, 1},//SUBQ.L #1,D0
+   {{0x0680, 0x7FFF, 0xFFFF}, 3},//ADDI.L #0x7FFFFFFF,D0
+   {{0x0480, 0x8000, 0x0000}, 3},//SUBI.L #0x80000000,D0
+   {{0x0C80, 0xFFFF, 0xFFFF}, 3},//CMPI.L #0xFFFFFFFF,D0
+   {{0x2840, 0xB9C1}, 2}//MOVEA.L D0,A4, CMPA.L D1,A4
+};
+
+static const uint32_t edgeValues[] = {0x00000000, 0x00000001, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFF, 0xFFFFFFFE};
+
+static uint32_t randomState = 0x12345678;
+
+
+static uint32_t randomValue(void){
+   randomState ^= randomState << 13;
+   randomState ^= randomState >> 17;
+   randomState ^= randomState << 5;
+   return randomState;
+}
+
+static uint32_t randomOperand(void){
+   if(randomValue() % 3 == 0)
+      return edgeValues[randomValue() % (sizeof(edgeValues) / sizeof(edgeValues[0]))] + randomValue() % 2;
+   return randomValue();
+}
+
+static uint32_t writeWord(uint32_t address, uint16_t value){
+   m68k_write_memory_16(address, value);
+   return address + 2;
+}
+
+int main(void){
+   uint8_t* rom = calloc(1, 0x400000);
+   uint32_t codeAddress = CODE_START;
+   uint32_t dataAddress = DATA_START;
+   uint32_t programEnd;
+   uint32_t hash = 2166136261u;
+   uint32_t address;
+   uint32_t block;
+   uint32_t slices;
+
+   if(emulatorInit(rom, 0x400000, NULL, 0, 0) != EMU_ERROR_NONE){
+      printf("emulatorInit failed\n");
+      return 1;
+   }
+
+   //plain RAM at 0x00000000 and the ROM out of the way at 0x10000000, nothing else is touched
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].inBootMode = false;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].enable = true;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].start = 0x10000000;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].lineSize = 0x400000;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].mask = 0x3FFFFF;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].enable = true;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].start = 0x00000000;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].lineSize = 0x800000;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask = 0x7FFFFF;
+   dbvzResetAddressSpace();
+
+   //LEA DATA_START,A0, LEA OUTPUT_START,A1
+   codeAddress = writeWord(codeAddress, 0x41F9);
+   codeAddress = writeWord(codeAddress, DATA_START >> 16);
+   codeAddress = writeWord(codeAddress, DATA_START & 0xFFFF);
+   codeAddress = writeWord(codeAddress, 0x43F9);
+   codeAddress = writeWord(codeAddress, OUTPUT_START >> 16);
+   codeAddress = writeWord(codeAddress, OUTPUT_START & 0xFFFF);
+
+   for(block = 0; block < TEST_BLOCKS; block++){
+      const flagOp_t* op = &flagOps[block % (sizeof(flagOps) / sizeof(flagOps[0]))];
+      uint8_t condition = 2 + block / (sizeof(flagOps) / sizeof(flagOps[0])) % 14;
+      uint32_t operand0 = randomOperand();
+      uint32_t operand1 = randomOperand();
+      uint8_t index;
+
+      dataAddress = writeWord(dataAddress, operand0 >> 16);
+      dataAddress = writeWord(dataAddress, operand0 & 0xFFFF);
+      dataAddress = writeWord(dataAddress, operand1 >> 16);
+      dataAddress = writeWord(dataAddress, operand1 & 0xFFFF);
+      dataAddress = writeWord(dataAddress, randomValue() & 0x1F);
+
+      codeAddress = writeWord(codeAddress, 0x2018);//MOVE.L (A0)+,D0
+      codeAddress = writeWord(codeAddress, 0x2218);//MOVE.L (A0)+,D1
+      codeAddress = writeWord(codeAddress, 0x44D8);//MOVE (A0)+,CCR
+      for(index = 0; index < op->length; index++)
+         codeAddress = writeWord(codeAddress, op->opcode[index]);
+      codeAddress = writeWord(codeAddress, 0x50C2 | condition << 8);//Scc D2
+      codeAddress = writeWord(codeAddress, 0x40D9);//MOVE SR,(A1)+
+      codeAddress = writeWord(codeAddress, 0xD181);//ADDX.L D1,D0
+      codeAddress = writeWord(codeAddress, 0x40D9);//MOVE SR,(A1)+
+      codeAddress = writeWord(codeAddress, 0x22C0);//MOVE.L D0,(A1)+
+      codeAddress = writeWord(codeAddress, 0x32C2);//MOVE.W D2,(A1)+
+   }
+
+   //STOP #0x2700
+   codeAddress = writeWord(codeAddress, 0x4E72);
+   codeAddress = writeWord(codeAddress, 0x2700);
+   programEnd = codeAddress;
+
+   m68k_set_reg(M68K_REG_SR, 0x2700);
+   m68k_set_reg(M68K_REG_A7, STACK_START);
+   m68k_set_reg(M68K_REG_PC, CODE_START);
+#if defined(EMU_NO_SAFETY)
+   flx68000PcLongJump(CODE_START);
+#endif
+   for(slices = 0; slices < 1000 && m68k_get_reg(NULL, M68K_REG_PC) != programEnd; slices++)
+      m68k_execute(100000);
+
+   if(m68k_get_reg(NULL, M68K_REG_PC) != programEnd){
+      printf("program didnt finish, PC:0x%08X\n", m68k_get_reg(NULL, M68K_REG_PC));
+      return 1;
+   }
+
+   for(address = OUTPUT_START; address < OUTPUT_START + TEST_BLOCKS * 10; address += 2)
+      hash = (hash ^ m68k_read_memory_16(address)) * 16777619u;
+
+   printf("hash:0x%08X\n", hash);
+   return hash != EXPECTED_HASH;
+}
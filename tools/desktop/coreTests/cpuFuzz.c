@@ -0,0 +1,579 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "dbvz.h"
+#include "m515Bus.h"
+#include "flx68000.h"
+#include "m68k/m68k.h"
+
+
+//builds a random m68k program from the seed given on the command line and runs it in random length slices,
+//the PC and a hash of the registers and test memory are printed after each slice so a recompiler build can be compared to an interpreter build
+//the program loops through branches, DBcc, BSR/JSR to small subroutines and exceptions that restart it, every 5th seed also patches its own code
+
+#define PROGRAM_START 0x00010000
+#define PROGRAM_INIT_END 0x0001001A
+#define SUBROUTINE_START 0x00014000
+#define SUBROUTINE_SIZE 0x200
+#define SUBROUTINES 4
+#define RESTART_HANDLER 0x00017F00
+#define STACK_START 0x00040000
+#define TEST_MEMORY_END 0x00050000
+#define MAX_INSTRUCTIONS 400
+#define SLICES 300
+
+enum{
+   BRANCH_NONE = 0,
+   BRANCH_SHORT,
+   BRANCH_WORD,
+   BRANCH_DBCC,
+   BRANCH_BSR,
+   BRANCH_JMP
+};
+
+enum{
+   EA_ANY = 0,
+   EA_MEMORY_ALTERABLE,
+   EA_DATA_ALTERABLE,
+   EA_CONTROL
+};
+
+typedef struct{
+   uint16_t words[12];
+   uint8_t  length;
+   uint8_t  branch;
+   uint32_t target;
+}instruction_t;
+
+static instruction_t program[MAX_INSTRUCTIONS];
+static uint32_t programLength;
+static bool selfModifying;
+static uint32_t randomState;
+
+
+static uint32_t randomValue(void){
+   randomState ^= randomState << 13;
+   randomState ^= randomState >> 17;
+   randomState ^= randomState << 5;
+   return randomState;
+}
+
+static uint32_t randomRange(uint32_t range){
+   return randomValue() % range;
+}
+
+static void addWord(instruction_t* instruction, uint16_t value){
+   instruction->words[instruction->length++] = value;
+}
+
+static void addWords(instruction_t* instruction, const uint16_t* words, uint8_t count){
+   uint8_t index;
+
+   for(index = 0; index < count; index++)
+      addWord(instruction, words[index]);
+}
+
+static uint16_t sizeBits(uint8_t size){
+   return size == 1 ? 0 : size == 2 ? 1 : 2;
+}
+
+static uint8_t randomSize(void){
+   uint8_t size = randomRange(3);
+
+   return size == 0 ? 1 : size == 1 ? 2 : 4;
+}
+
+static uint16_t dataDestination(void){
+   //D7 is the index register, it is never written
+   return randomRange(7);
+}
+
+static uint16_t randomEa(uint8_t kind, uint8_t size, uint16_t* extension, uint8_t* extensionLength){
+   uint8_t mode;
+
+   *extensionLength = 0;
+   while(true){
+      mode = randomRange(12);
+      if(kind == EA_ANY)
+         break;
+      if(kind == EA_MEMORY_ALTERABLE && mode >= 2 && mode <= 8)
+         break;
+      if(kind == EA_DATA_ALTERABLE && mode != 1 && mode <= 8)
+         break;
+      if(kind == EA_CONTROL && (mode == 2 || (mode >= 5 && mode <= 10)))
+         break;
+   }
+   if(mode == 1 && size == 1)
+      mode = 0;
+
+   switch(mode){
+      case 0:
+         return randomRange(8);
+
+      case 1:
+         return 0x08 | randomRange(8);
+
+      case 2:
+         return 0x10 | randomRange(4);
+
+      case 3:
+         return 0x18 | randomRange(4);
+
+      case 4:
+         return 0x20 | randomRange(4);
+
+      case 5:
+         extension[(*extensionLength)++] = ((randomRange(0x200) - 0x100) & 0xFFFE) | (size == 1 ? randomRange(2) : 0);
+         return 0x28 | randomRange(4);
+
+      case 6:
+         extension[(*extensionLength)++] = (randomRange(2) ? 0x7000 : 0x7800) | (randomRange(0x40) & (size == 1 ? 0xFF : 0xFE));
+         return 0x30 | randomRange(4);
+
+      case 7:
+         extension[(*extensionLength)++] = selfModifying ? 0x1000 + (randomRange(0x400) & 0xFFFE) : 0x2000 + (randomRange(0x1000) & 0xFFFE);
+         return 0x38;
+
+      case 8:{
+            uint32_t address = selfModifying && randomRange(2) ? 0x10000 + (randomRange(0x800) & 0xFFFE) : 0x20000 + (randomRange(0x1000) & 0xFFFE);
+
+            extension[(*extensionLength)++] = address >> 16;
+            extension[(*extensionLength)++] = address & 0xFFFF;
+            return 0x39;
+         }
+
+      case 9:
+         extension[(*extensionLength)++] = randomRange(0x40) & 0xFFFE;
+         return 0x3A;
+
+      case 10:
+         extension[(*extensionLength)++] = 0x7000 | (randomRange(0x20) & 0xFFFE);
+         return 0x3B;
+
+      default:
+         if(kind != EA_ANY)
+            return randomRange(8);
+         if(size == 4){
+            extension[(*extensionLength)++] = randomValue();
+            extension[(*extensionLength)++] = randomValue();
+         }
+         else{
+            extension[(*extensionLength)++] = size == 1 ? randomRange(0x100) : randomValue();
+         }
+         return 0x3C;
+   }
+}
+
+static void randomInstruction(instruction_t* instruction, bool inSubroutine){
+   static const uint16_t moveSizes[3] = {0x1000, 0x3000, 0x2000};
+   static const uint16_t arithmeticOps[5] = {0xD000, 0x9000, 0xC000, 0x8000, 0xB000};
+   static const uint16_t immediateOps[6] = {0x0000, 0x0200, 0x0400, 0x0600, 0x0A00, 0x0C00};
+   uint16_t sourceExtension[4];
+   uint16_t destinationExtension[4];
+   uint8_t sourceLength;
+   uint8_t destinationLength;
+   uint8_t size = randomSize();
+   uint16_t source;
+   uint16_t destination;
+   uint16_t op;
+
+   memset(instruction, 0x00, sizeof(instruction_t));
+
+   //subroutines only get straight line code
+   switch(randomRange(inSubroutine ? 24 : 30)){
+      case 0:
+      case 1:
+      case 2:
+         //MOVE
+         source = randomEa(EA_ANY, size, sourceExtension, &sourceLength);
+         if(randomRange(4) == 0){
+            addWord(instruction, moveSizes[sizeBits(size)] | dataDestination() << 9 | source);
+            addWords(instruction, sourceExtension, sourceLength);
+         }
+         else{
+            destination = randomEa(EA_MEMORY_ALTERABLE, size, destinationExtension, &destinationLength);
+            addWord(instruction, moveSizes[sizeBits(size)] | (destination & 0x07) << 9 | (destination >> 3) << 6 | source);
+            addWords(instruction, sourceExtension, sourceLength);
+            addWords(instruction, destinationExtension, destinationLength);
+         }
+         break;
+
+      case 3:
+         //MOVEQ
+         addWord(instruction, 0x7000 | dataDestination() << 9 | randomRange(0x100));
+         break;
+
+      case 4:
+      case 5:
+      case 6:
+         //ADD, SUB, AND, OR, CMP <ea>,Dn
+         op = arithmeticOps[randomRange(5)];
+         source = randomEa(EA_ANY, size, sourceExtension, &sourceLength);
+         if((op == 0xC000 || op == 0x8000) && (source >> 3) == 1)
+            source &= 0x07;
+         addWord(instruction, op | dataDestination() << 9 | sizeBits(size) << 6 | source);
+         addWords(instruction, sourceExtension, sourceLength);
+         break;
+
+      case 7:
+         //EOR Dn,Dn
+         addWord(instruction, 0xB100 | randomRange(8) << 9 | sizeBits(size) << 6 | dataDestination());
+         break;
+
+      case 8:
+         //ORI, ANDI, SUBI, ADDI, EORI, CMPI
+         op = immediateOps[randomRange(6)];
+         if(op == 0x0C00 && randomRange(2)){
+            destination = randomEa(EA_MEMORY_ALTERABLE, size, destinationExtension, &destinationLength);
+         }
+         else{
+            destination = dataDestination();
+            destinationLength = 0;
+         }
+         addWord(instruction, op | sizeBits(size) << 6 | destination);
+         if(size == 4){
+            addWord(instruction, randomValue());
+            addWord(instruction, randomValue());
+         }
+         else{
+            addWord(instruction, size == 1 ? randomRange(0x100) : randomValue());
+         }
+         addWords(instruction, destinationExtension, destinationLength);
+         break;
+
+      case 9:
+         //ADDQ, SUBQ to a data register or A1/A2
+         if(randomRange(3))
+            addWord(instruction, 0x5000 | randomRange(8) << 9 | randomRange(2) << 8 | sizeBits(size) << 6 | dataDestination());
+         else
+            addWord(instruction, 0x5000 | (1 + randomRange(2)) << 9 | randomRange(2) << 8 | (1 + randomRange(2)) << 6 | 0x08 | randomRange(4));
+         break;
+
+      case 10:
+         //ADDA, SUBA, CMPA to A4/A5
+         if(size == 1)
+            size = 2;
+         source = randomEa(EA_ANY, size, sourceExtension, &sourceLength);
+         addWord(instruction, (randomRange(3) == 0 ? 0xD000 : randomRange(2) ? 0x9000 : 0xB000) | (4 + randomRange(2)) << 9 | (size == 4) << 8 | 0xC0 | source);
+         addWords(instruction, sourceExtension, sourceLength);
+         break;
+
+      case 11:
+         //TST
+         source = randomEa(EA_DATA_ALTERABLE, size, sourceExtension, &sourceLength);
+         if(randomRange(2)){
+            addWord(instruction, 0x4A00 | sizeBits(size) << 6 | source);
+            addWords(instruction, sourceExtension, sourceLength);
+         }
+         else{
+            addWord(instruction, 0x4A00 | sizeBits(size) << 6 | dataDestination());
+         }
+         break;
+
+      case 12:
+         //CLR
+         if(randomRange(2)){
+            destination = randomEa(EA_MEMORY_ALTERABLE, size, destinationExtension, &destinationLength);
+         }
+         else{
+            destination = dataDestination();
+            destinationLength = 0;
+         }
+         addWord(instruction, 0x4200 | sizeBits(size) << 6 | destination);
+         addWords(instruction, destinationExtension, destinationLength);
+         break;
+
+      case 13:
+         //NEG, NOT
+         addWord(instruction, (randomRange(2) ? 0x4400 : 0x4600) | sizeBits(size) << 6 | dataDestination());
+         break;
+
+      case 14:
+         //SWAP, EXT.W, EXT.L
+         addWord(instruction, (randomRange(3) == 0 ? 0x4840 : randomRange(2) ? 0x4880 : 0x48C0) | dataDestination());
+         break;
+
+      case 15:
+      case 16:
+         //shifts and rotates, by a register count some of the time
+         addWord(instruction, 0xE000 | randomRange(8) << 9 | randomRange(2) << 8 | sizeBits(size) << 6 | (randomRange(6) == 0) << 5 | randomRange(4) << 3 | dataDestination());
+         break;
+
+      case 17:
+         //BTST #
+         if(randomRange(2)){
+            addWord(instruction, 0x0800 | dataDestination());
+            addWord(instruction, randomRange(0x40));
+         }
+         else{
+            source = randomEa(EA_ANY, 1, sourceExtension, &sourceLength);
+            if((source >> 3) == 1 || source == 0x3C)
+               source = 0x10;
+            addWord(instruction, 0x0800 | source);
+            addWord(instruction, randomRange(0x40));
+            addWords(instruction, sourceExtension, sourceLength);
+         }
+         break;
+
+      case 18:
+         //LEA to A4/A5
+         source = randomEa(EA_CONTROL, 4, sourceExtension, &sourceLength);
+         addWord(instruction, 0x41C0 | (4 + randomRange(2)) << 9 | source);
+         addWords(instruction, sourceExtension, sourceLength);
+         break;
+
+      case 19:
+         //NOP
+         addWord(instruction, 0x4E71);
+         break;
+
+      case 20:
+         //MULU Dn,Dn
+         addWord(instruction, 0xC0C0 | dataDestination() << 9 | randomRange(8));
+         break;
+
+      case 21:
+         //ADD Dn,(An)
+         addWord(instruction, 0xD100 | dataDestination() << 9 | sizeBits(size) << 6 | 0x10 | randomRange(4));
+         break;
+
+      case 22:
+         //PEA, ADDQ.L #4,A7
+         source = randomEa(EA_CONTROL, 4, sourceExtension, &sourceLength);
+         addWord(instruction, 0x4840 | source);
+         addWords(instruction, sourceExtension, sourceLength);
+         addWord(instruction, 0x588F);
+         break;
+
+      case 23:
+         //Scc
+         addWord(instruction, 0x50C0 | randomRange(16) << 8 | dataDestination());
+         break;
+
+      case 24:
+      case 25:
+         //Bcc, the displacement is filled in after layout
+         instruction->branch = BRANCH_SHORT;
+         instruction->target = randomRange(programLength);
+         addWord(instruction, 0x6000 | (2 + randomRange(14)) << 8);
+         if(randomRange(2)){
+            addWord(instruction, 0x0000);
+            instruction->branch = BRANCH_WORD;
+         }
+         break;
+
+      case 26:
+         //DBcc
+         instruction->branch = BRANCH_DBCC;
+         instruction->target = randomRange(programLength);
+         addWord(instruction, 0x51C8 | randomRange(16) << 8 | randomRange(6));
+         addWord(instruction, 0x0000);
+         break;
+
+      case 27:
+         //BSR.W
+         instruction->branch = BRANCH_BSR;
+         instruction->target = randomRange(SUBROUTINES);
+         addWord(instruction, 0x6100);
+         addWord(instruction, 0x0000);
+         break;
+
+      case 28:
+         //JSR to a subroutine
+         addWord(instruction, 0x4EB9);
+         addWord(instruction, SUBROUTINE_START >> 16);
+         addWord(instruction, (SUBROUTINE_START & 0xFFFF) + randomRange(SUBROUTINES) * SUBROUTINE_SIZE);
+         break;
+
+      case 29:
+         //JMP
+         instruction->branch = BRANCH_JMP;
+         instruction->target = randomRange(programLength);
+         addWord(instruction, 0x4EF9);
+         addWord(instruction, 0x0000);
+         addWord(instruction, 0x0000);
+         break;
+   }
+}
+
+static uint32_t writeWord(uint32_t address, uint16_t value){
+   m68k_write_memory_16(address, value);
+   return address + 2;
+}
+
+static uint32_t writeInstruction(uint32_t address, const instruction_t* instruction){
+   uint8_t index;
+
+   for(index = 0; index < instruction->length; index++)
+      address = writeWord(address, instruction->words[index]);
+   return address;
+}
+
+static uint32_t hashState(void){
+   uint32_t hash = 2166136261u;
+   uint32_t address;
+   uint8_t reg;
+
+   for(reg = M68K_REG_D0; reg <= M68K_REG_A7; reg++)
+      hash = (hash ^ m68k_get_reg(NULL, reg)) * 16777619u;
+   hash = (hash ^ m68k_get_reg(NULL, M68K_REG_SR)) * 16777619u;
+   for(address = 0x00000000; address < TEST_MEMORY_END; address += 2)
+      hash = (hash ^ m68k_read_memory_16(address)) * 16777619u;
+
+   return hash;
+}
+
+int main(int argc, char* argv[]){
+   static const uint16_t programInit[] = {
+      0x41F9, 0x0002, 0x0100,//LEA 0x20100,A0
+      0x43F9, 0x0002, 0x0400,//LEA 0x20400,A1
+      0x45F9, 0x0002, 0x0800,//LEA 0x20800,A2
+      0x47F9, 0x0002, 0x0C00,//LEA 0x20C00,A3
+      0x7E10//MOVEQ #0x10,D7
+   };
+   uint8_t* rom = calloc(1, 0x400000);
+   uint32_t addresses[MAX_INSTRUCTIONS];
+   uint32_t address;
+   uint32_t seed;
+   uint32_t index;
+   uint32_t slice;
+
+   if(argc < 2){
+      printf("usage: cpuFuzz <seed>\n");
+      return 1;
+   }
+   seed = strtoul(argv[1], NULL, 0);
+   randomState = seed * 2654435761u + 1;
+   selfModifying = seed % 5 == 0;
+
+   if(emulatorInit(rom, 0x400000, NULL, 0, 0) != EMU_ERROR_NONE){
+      printf("emulatorInit failed\n");
+      return 1;
+   }
+
+   //plain RAM at 0x00000000 and the ROM out of the way at 0x10000000, nothing else is touched
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].inBootMode = false;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].enable = true;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].start = 0x10000000;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].lineSize = 0x400000;
+   dbvzChipSelects[DBVZ_CHIP_A0_ROM].mask = 0x3FFFFF;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].enable = true;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].start = 0x00000000;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].lineSize = 0x800000;
+   dbvzChipSelects[DBVZ_CHIP_DX_RAM].mask = 0xFFFFFF;
+   dbvzResetAddressSpace();
+
+   //random data everywhere except for a sled of NOPs under the code
+   for(address = 0x00000000; address < TEST_MEMORY_END; address += 2)
+      m68k_write_memory_16(address, address >= PROGRAM_START && address < PROGRAM_START + 0x8000 ? 0x4E71 : randomValue());
+
+   //every exception vector goes to a handler that resets the stack and restarts the program
+   for(address = 0x00000008; address < 0x00000400; address += 4){
+      m68k_write_memory_16(address, RESTART_HANDLER >> 16);
+      m68k_write_memory_16(address + 2, RESTART_HANDLER & 0xFFFF);
+   }
+   address = RESTART_HANDLER;
+   address = writeWord(address, 0x4FF9);//LEA STACK_START,A7
+   address = writeWord(address, STACK_START >> 16);
+   address = writeWord(address, STACK_START & 0xFFFF);
+   address = writeWord(address, 0x4EF9);//JMP PROGRAM_START
+   address = writeWord(address, PROGRAM_START >> 16);
+   address = writeWord(address, PROGRAM_START & 0xFFFF);
+
+   programLength = 20 + randomRange(150);
+   for(index = 0; index < programLength; index++)
+      randomInstruction(&program[index], false);
+
+   address = PROGRAM_START;
+   for(index = 0; index < sizeof(programInit) / sizeof(programInit[0]); index++)
+      address = writeWord(address, programInit[index]);
+
+   //self modifying seeds point A0 at the program itself
+   if(selfModifying){
+      m68k_write_memory_16(PROGRAM_START + 0x08, 0x0001);
+      m68k_write_memory_16(PROGRAM_START + 0x0A, 0x0000);
+   }
+
+   //lay out the program then fill in the branches, a short branch that doesnt fit becomes a NOP so nothing moves
+   for(index = 0; index < programLength; index++){
+      addresses[index] = address;
+      address += program[index].length * 2;
+   }
+   for(index = 0; index < programLength; index++){
+      instruction_t* instruction = &program[index];
+      int32_t displacement;
+
+      switch(instruction->branch){
+         case BRANCH_SHORT:
+            displacement = addresses[instruction->target] - (addresses[index] + 2);
+            if(displacement < -128 || displacement > 127 || displacement == 0 || displacement == -1)
+               instruction->words[0] = 0x4E71;
+            else
+               instruction->words[0] |= displacement & 0xFF;
+            break;
+
+         case BRANCH_WORD:
+         case BRANCH_DBCC:
+            instruction->words[1] = addresses[instruction->target] - (addresses[index] + 2);
+            break;
+
+         case BRANCH_BSR:
+            instruction->words[1] = SUBROUTINE_START + instruction->target * SUBROUTINE_SIZE - (addresses[index] + 2);
+            break;
+
+         case BRANCH_JMP:
+            instruction->words[1] = addresses[instruction->target] >> 16;
+            instruction->words[2] = addresses[instruction->target] & 0xFFFF;
+            break;
+      }
+   }
+
+   address = PROGRAM_INIT_END;
+   for(index = 0; index < programLength; index++)
+      address = writeInstruction(address, &program[index]);
+   address = writeWord(address, 0x4EF9);//JMP PROGRAM_START
+   address = writeWord(address, PROGRAM_START >> 16);
+   address = writeWord(address, PROGRAM_START & 0xFFFF);
+
+   //LINK A6,#-8, MOVEM.L D0-D2/A4(/D3),-(A7), random code, MOVEM.L (A7)+,D0-D2/A4(/A3), UNLK A6, RTS
+   for(index = 0; index < SUBROUTINES; index++){
+      instruction_t instruction;
+      uint32_t length = randomRange(20);
+      uint32_t count;
+
+      address = SUBROUTINE_START + index * SUBROUTINE_SIZE;
+      address = writeWord(address, 0x4E56);
+      address = writeWord(address, 0xFFF8);
+      address = writeWord(address, 0x48E7);
+      address = writeWord(address, 0xE008 | randomRange(2) << 12);
+      for(count = 0; count < length; count++){
+         randomInstruction(&instruction, true);
+         address = writeInstruction(address, &instruction);
+      }
+      address = writeWord(address, 0x4CDF);
+      address = writeWord(address, 0x1007 | randomRange(2) << 3);
+      address = writeWord(address, 0x4E5E);
+      address = writeWord(address, 0x4E75);
+   }
+
+   m68k_set_reg(M68K_REG_SR, 0x2700);
+   m68k_set_reg(M68K_REG_A7, STACK_START);
+   m68k_set_reg(M68K_REG_PC, PROGRAM_START);
+#if defined(EMU_NO_SAFETY)
+   flx68000PcLongJump(PROGRAM_START);
+#endif
+
+   for(slice = 0; slice < SLICES; slice++){
+      int32_t cycles = m68k_execute(1 + randomRange(4000));
+
+      printf("seed:%u slice:%u cycles:%d PC:0x%08X hash:0x%08X\n", seed, slice, cycles, m68k_get_reg(NULL, M68K_REG_PC), hashState());
+   }
+
+   emulatorDeinit();
+   free(rom);
+   return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "sed1376.h"
+#include "specs/sed1376RegisterSpec.h"
+
+
+//renders random VRAM in every bit depth, panel type, inversion and backlight level and prints a hash of each frame
+//a PIP window that starts and ends part way through a line leaves spans that arent a multiple of the SIMD width, the output has to match a build with EMU_NO_SIMD
+//and every frame has to match what the old per pixel renderer drew
+
+static const char* bitDepthNames[] = {"1", "2", "4", "8", "16"};
+static const char* dimNames[] = {"1/4", "1/2", "full"};
+
+//frame hashes from the renderer before the line based and SIMD drawing, in loop order
+static const uint32_t expectedHashes[] = {
+   0x27F0F0AB, 0xE39470C9, 0xD9282C43, 0x5359B10E, 0x99193369, 0x61D2AE34,
+   0xBC34AE85, 0x87BBD571, 0x7B072120, 0xF1EC1B95, 0x0A184F11, 0x2690B045,
+   0x2C6A2A26, 0xB1AFAF9B, 0x4FA7D61C, 0xBA3B0A42, 0x02172E74, 0x7837F83E,
+   0x4F862FA6, 0xB356EA55, 0x78864B18, 0x484A7C35, 0xCE5FEE97, 0x59B47296,
+   0x52B9E99D, 0x9AC1E6C1, 0x25D8FCFA, 0x1982440E, 0xA5836F9F, 0x30331805,
+   0x1805DC27, 0xA1EDC1FA, 0xF19388C9, 0xEB542CAF, 0x6688ED05, 0xE0443907,
+   0x4582EC4B, 0x217287FA, 0x60AD2CA9, 0x3EA21F49, 0xEBCA2BE8, 0x8C44CBD7,
+   0x46AEEF3E, 0x12D38988, 0x26A07D0C, 0xE0ABBA7F, 0x79B99C51, 0x83C7F603,
+   0x5C402AE8, 0x31E3BF09, 0xB5C412A9, 0x87FF93B7, 0xF5B9351D, 0x5554AA48,
+   0xE6A91B28, 0x20BB9B5F, 0x4727D921, 0x1771DEB9, 0xD4726C63, 0x4B027F89
+};
+
+static uint32_t randomState = 0x9E3779B9;
+
+
+static uint32_t randomValue(void){
+   randomState ^= randomState << 13;
+   randomState ^= randomState >> 17;
+   randomState ^= randomState << 5;
+   return randomState;
+}
+
+int main(void){
+   uint8_t* rom = calloc(1, 0x400000);
+   uint8_t bitDepth;
+   uint8_t color;
+   uint8_t invert;
+   uint8_t dim;
+   uint32_t index;
+   uint8_t frame = 0;
+   bool failed = false;
+
+   if(emulatorInit(rom, 0x400000, NULL, 0, 0) != EMU_ERROR_NONE){
+      printf("emulatorInit failed\n");
+      return 1;
+   }
+
+   for(bitDepth = 0; bitDepth < 5; bitDepth++){
+      for(color = 0; color < 2; color++){
+         for(invert = 0; invert < 2; invert++){
+            for(dim = 0; dim < 3; dim++){
+               uint32_t hash = 2166136261u;
+
+               for(index = 0; index < SED1376_RAM_SIZE; index++)
+                  sed1376Ram[index] = randomValue();
+               memset(sed1376RamDirtyBlocks, 0xFF, SED1376_RAM_SIZE / SED1376_DIRTY_BLOCK_SIZE / 8);
+               for(index = 0; index < 256; index++){
+                  sed1376SetRegister(LUT_B_WRITE, randomValue());
+                  sed1376SetRegister(LUT_G_WRITE, randomValue());
+                  sed1376SetRegister(LUT_R_WRITE, randomValue());
+                  sed1376SetRegister(LUT_WRITE_LOC, index);
+               }
+
+               //screen on, main window at 0 and a PIP window from x 2 to 27 in 16 bpp at 0x8000
+               //16 bpp monochrome steps lineSize * 2 per line, so the PIP window has to end below 0x8000 + 150 * 640 + 56 bytes to stay inside SED1376_RAM_SIZE
+               sed1376SetRegister(GPIO_CONF_0, 0x20);
+               sed1376SetRegister(GPIO_CONT_0, 0x20);
+               sed1376SetRegister(PWR_SAVE_CFG, 0x00);
+               sed1376SetRegister(DISP_MODE, bitDepth | (invert ? 0x10 : 0x00));
+               sed1376SetRegister(PANEL_TYPE, color ? 0x40 : 0x00);
+               sed1376SetRegister(SPECIAL_EFFECT, 0x10);
+               sed1376SetRegister(DISP_ADDR_0, 0x00);
+               sed1376SetRegister(DISP_ADDR_1, 0x00);
+               sed1376SetRegister(DISP_ADDR_2, 0x00);
+               sed1376SetRegister(LINE_SIZE_0, 80);
+               sed1376SetRegister(LINE_SIZE_1, 0x00);
+               sed1376SetRegister(PIP_ADDR_0, 0x00);
+               sed1376SetRegister(PIP_ADDR_1, 0x20);
+               sed1376SetRegister(PIP_ADDR_2, 0x00);
+               sed1376SetRegister(PIP_LINE_SZ_0, 80);
+               sed1376SetRegister(PIP_LINE_SZ_1, 0x00);
+               sed1376SetRegister(PIP_X_START_0, 1);
+               sed1376SetRegister(PIP_X_START_1, 0x00);
+               sed1376SetRegister(PIP_X_END_0, 13);
+               sed1376SetRegister(PIP_X_END_1, 0x00);
+               sed1376SetRegister(PIP_Y_START_0, 7);
+               sed1376SetRegister(PIP_Y_START_1, 0x00);
+               sed1376SetRegister(PIP_Y_END_0, 150);
+               sed1376SetRegister(PIP_Y_END_1, 0x00);
+               palmMisc.lcdOn = true;
+               palmMisc.backlightLevel = dim;
+
+               sed1376Snapshot();
+               if(!sed1376Render()){
+                  printf("bpp:%s color:%d invert:%d dim:%s nothing was rendered\n", bitDepthNames[bitDepth], color, invert, dimNames[dim]);
+                  failed = true;
+                  continue;
+               }
+
+               for(index = 0; index < 160 * 160; index++)
+                  hash = (hash ^ sed1376Framebuffer[index]) * 16777619u;
+               printf("bpp:%s color:%d invert:%d dim:%s hash:0x%08X\n", bitDepthNames[bitDepth], color, invert, dimNames[dim], hash);
+               if(hash != expectedHashes[frame]){
+                  printf("expected hash:0x%08X\n", expectedHashes[frame]);
+                  failed = true;
+               }
+               frame++;
+            }
+         }
+      }
+   }
+
+   emulatorDeinit();
+   free(rom);
+   return failed;
+}
@@ -34,19 +34,19 @@ These registers will do nothing if their corresponding feature bit is not set on
 /*new registers go here*/
 
 /*commands*/
-#define CMD_MEMCPY       0x00000000
-#define CMD_MEMSET       0x00000001
-#define CMD_MEMCMP       0x00000002
-#define CMD_STRCPY       0x00000003
-#define CMD_STRNCPY      0x00000004
-#define CMD_STRCMP       0x00000005
-#define CMD_STRNCMP      0x00000006
+#define CMD_MEMCPY       0x00000000/*EMU_DST = destination, EMU_SRC = source, EMU_SIZE = bytes, overlapping areas are allowed*/
+#define CMD_MEMSET       0x00000001/*EMU_DST = destination, EMU_VALUE = byte, EMU_SIZE = bytes*/
+#define CMD_MEMCMP       0x00000002/*EMU_SRC = first area, EMU_DST = second area, EMU_SIZE = bytes, EMU_VALUE is set to the difference of the first unequal bytes or 0*/
+#define CMD_STRCPY       0x00000003/*EMU_DST = destination, EMU_SRC = source*/
+#define CMD_STRNCPY      0x00000004/*EMU_DST = destination, EMU_SRC = source, EMU_SIZE = max bytes, the rest is filled with 0s like strncpy*/
+#define CMD_STRCMP       0x00000005/*EMU_SRC = first string, EMU_DST = second string, EMU_VALUE is set like CMD_MEMCMP*/
+#define CMD_STRNCMP      0x00000006/*EMU_SRC = first string, EMU_DST = second string, EMU_SIZE = max bytes, EMU_VALUE is set like CMD_MEMCMP*/
 /*new HLE API cmds go here*/
 
 /*new system cmds go here*/
 #define CMD_SET_CPU_SPEED  0x0000FFF3/*EMU_VALUE = CPU speed percent, 100% = normal*/
 #define CMD_IDLE_X_CLK32   0x0000FFF4/*EMU_VALUE = CLK32s to waste, used to remove idle loops*/
-#define CMD_SET_CYCLE_COST 0x0000FFF5/*EMU_DST = HLE API number, EMU_VALUE = how many cycles it takes*/
+#define CMD_SET_CYCLE_COST 0x0000FFF5/*EMU_DST = HLE API number, EMU_VALUE = how many CPU cycles each call takes, 0 on reset*/
 /*CMD_UNUSED               0x0000FFF6*/
 /*CMD_UNUSED               0x0000FFF7*/
 #define CMD_DEBUG_PRINT    0x0000FFF8/*EMU_SRC = pointer to string*/